@@ -54,6 +54,38 @@ UnityCommand StringToUnityCommand(const char* name)
 	return cur->id;
 }
 
+UnityCommandPriority UnityCommandToPriority(UnityCommand c)
+{
+	switch (c)
+	{
+	case UCOM_Incoming:
+	case UCOM_IncomingChangeAssets:
+	case UCOM_Changes:
+	case UCOM_ChangeStatus:
+		return UCP_Background;
+	case UCOM_Invalid:
+	case UCOM_Shutdown:
+	case UCOM_Config:
+	case UCOM_Exit:
+	case UCOM_Login:
+	case UCOM_Login2:
+	case UCOM_QueryConfigParameters:
+		return UCP_Control;
+	default:
+		return UCP_Interactive;
+	}
+}
+
+const char* UnityCommandPriorityToString(UnityCommandPriority p)
+{
+	switch (p)
+	{
+	case UCP_Interactive: return "interactive";
+	case UCP_Background: return "background";
+	default: return "control";
+	}
+}
+
 CommandException::CommandException(UnityCommand c, const std::string& about)
 { 
 	m_What += UnityCommandToString(c);
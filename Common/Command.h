@@ -40,6 +40,18 @@ enum UnityCommand
 const char* UnityCommandToString(UnityCommand c);
 UnityCommand StringToUnityCommand(const char* name);
 
+// Interactive commands are the ones the user waits for. Background commands
+// are the polls Unity sends by itself to keep its views up to date.
+enum UnityCommandPriority
+{
+	UCP_Control,     // configuration, login and shutdown
+	UCP_Interactive,
+	UCP_Background
+};
+
+UnityCommandPriority UnityCommandToPriority(UnityCommand c);
+const char* UnityCommandPriorityToString(UnityCommandPriority p);
+
 class CommandException : public std::exception
 {
 public:
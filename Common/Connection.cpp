@@ -1,6 +1,7 @@
 #include "Connection.h"
 #include "Utility.h"
 #include "FileSystem.h"
+#include "Thread.h"
 
 const char* DATA_PREFIX = "o";
 const char* VERBOSE_PREFIX = "v";
@@ -11,26 +12,23 @@ const char* COMMAND_PREFIX = "c";
 const char* PROGRESS_PREFIX = "p";
 
 const size_t MAX_LOG_FILE_SIZE = 2000000; 
+const int LOG_FILE_GENERATIONS = 5; // compressed archives kept when rotating the log
+const Microseconds DEFAULT_PROGRESS_INTERVAL_US = 250 * 1000; // a few updates per second at most
 
 Connection::Connection(const std::string& logPath) 
-	: m_Log(NULL), m_Pipe(NULL) 
+	: m_Log(NULL), m_Pipe(NULL), m_CommandStartBytesWritten(0), m_Capture(new ThreadLocalPointer()), m_Recording(NULL),
+	  m_ProgressInterval(DEFAULT_PROGRESS_INTERVAL_US)
 { 
-	// Rotate log file if too large
-	if (PathExists(logPath) && GetFileLength(logPath) > MAX_LOG_FILE_SIZE)
-	{
-		std::string prevPath(logPath);
-		prevPath += "-prev";
-		if (PathExists(prevPath))
-			DeleteRecursive(prevPath);
-		MoveAFile(logPath, prevPath);
-	}
-	m_Log = new LogStream(logPath);
+	// The log is rotated while running when it grows too large
+	m_Log = new LogStream(logPath, LOG_NOTICE, MAX_LOG_FILE_SIZE, LOG_FILE_GENERATIONS);
 }
 
 Connection::~Connection()
 {
 	delete m_Pipe;
 	m_Pipe = NULL;
+	delete m_Capture;
+	m_Capture = NULL;
 }
 
 void Connection::Connect()
@@ -89,6 +87,9 @@ UnityCommand Connection::ReadCommand(CommandArgs& args)
 		ErrorLine(std::string("invalid formatted - '") + command + "'");
 		return UCOM_Invalid;
 	}
+
+	m_Metrics.BeginUnityCommand(args[0]);
+	m_CommandStartBytesWritten = m_Pipe->GetBytesWritten();
 	return StringToUnityCommand(args[0].c_str());
 }
 
@@ -97,11 +98,72 @@ LogStream& Connection::Log()
 	return *m_Log;
 }
 
+Metrics& Connection::GetMetrics()
+{
+	ConnectionCapture* capture = GetCapture();
+	return capture ? capture->metrics : m_Metrics;
+}
+
+Tracer& Connection::GetTracer()
+{
+	ConnectionCapture* capture = GetCapture();
+	return capture ? capture->tracer : m_Tracer;
+}
+
+ConnectionCapture* Connection::GetCapture() const
+{
+	return (ConnectionCapture*)m_Capture->Get();
+}
+
+void Connection::BeginCapture(const std::string& name)
+{
+	ConnectionCapture* capture = new ConnectionCapture();
+	if (!name.empty())
+		capture->metrics.BeginUnityCommand(name);
+	m_Capture->Set(capture);
+}
+
+ConnectionCapture* Connection::EndCapture()
+{
+	ConnectionCapture* capture = GetCapture();
+	m_Capture->Set(NULL);
+	if (capture && capture->metrics.EndUnityCommand())
+		INFO_LOG(*m_Log) << "Metrics: " << capture->metrics.GetSummary() << Endl;
+	return capture;
+}
+
+void Connection::SendCaptured(const ConnectionCapture& capture)
+{
+	m_Metrics.Add(capture.metrics);
+	if (capture.output.empty())
+		return;
+	m_Pipe->Write(capture.output);
+	m_Pipe->Flush();
+	if (m_Recording)
+		*m_Recording += capture.output;
+}
+
+void Connection::RecordResponse(std::string* target)
+{
+	m_Recording = target;
+}
+
+void Connection::Resend(const std::string& recorded)
+{
+	m_Pipe->Write(recorded);
+	m_Pipe->Flush();
+}
+
 bool Connection::IsConnected() const
 {
 	return m_Pipe != NULL;
 }
 
+bool Connection::HasInput() const
+{
+	return m_Pipe != NULL && m_Pipe->HasInput();
+}
+
 /*
 Pipe& Connection::GetPipe()
 {
@@ -112,7 +174,34 @@ Pipe& Connection::GetPipe()
 void Connection::Flush()
 {
 	m_Log->Flush();
-	m_Pipe->Flush();
+	if (!GetCapture())
+		m_Pipe->Flush();
+}
+
+void Connection::Output(const std::string& v)
+{
+	ConnectionCapture* capture = GetCapture();
+	if (capture)
+	{
+		capture->output += v;
+		return;
+	}
+	m_Pipe->Write(v);
+	if (m_Recording)
+		*m_Recording += v;
+}
+
+void Connection::Output(const char* v)
+{
+	ConnectionCapture* capture = GetCapture();
+	if (capture)
+	{
+		capture->output += v;
+		return;
+	}
+	m_Pipe->Write(v);
+	if (m_Recording)
+		*m_Recording += v;
 }
 
 Connection& Connection::BeginList()
@@ -131,8 +220,15 @@ Connection& Connection::EndList()
 
 Connection& Connection::EndResponse()
 {
+	m_Recording = NULL;
 	WriteLine("r1:end of response", m_Log->Debug());
-	m_Log->Debug() << "\n--------------------------\n";
+
+	m_Metrics.AddBytesWritten((size_t)(m_Pipe->GetBytesWritten() - m_CommandStartBytesWritten));
+	m_CommandStartBytesWritten = m_Pipe->GetBytesWritten();
+	if (m_Metrics.EndUnityCommand())
+		INFO_LOG(*m_Log) << "Metrics: " << m_Metrics.GetSummary() << "\n";
+
+	DEBUG_LOG(*m_Log) << "\n--------------------------\n";
 	m_Log->Flush();
 	return *this;
 }
@@ -214,10 +310,20 @@ Connection& Connection::WritePrefix(const char* prefix, MessageArea ma, LogWrite
 // Encode newlines in strings
 Connection& Connection::Write(const std::string& v, LogWriter& log)
 {
+	// Most strings have nothing to encode so avoid the copies
+	if (v.find_first_of("\\\n") == std::string::npos)
+	{
+		if (log.IsOn())
+			log << v;
+		Output(v);
+		return *this;
+	}
+
 	std::string tmp = Replace(v, "\\", "\\\\");
 	tmp = Replace(tmp, "\n", "\\n");
-	log << tmp;
-	m_Pipe->Write(tmp);
+	if (log.IsOn())
+		log << tmp;
+	Output(tmp);
 	return *this;
 }
 
@@ -230,7 +336,7 @@ Connection& Connection::Write(const char* v, LogWriter& log)
 Connection& Connection::WriteEndl(LogWriter& log)
 {
 	log << "\n";
-	m_Pipe->Write("\n");
+	Output("\n");
 	return *this;
 }
 
@@ -3,6 +3,8 @@
 #include <vector>
 #include <set>
 #include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include "Pipe.h"
 #include "Command.h"
 
@@ -26,6 +28,17 @@ extern const char* INFO_PREFIX;
 extern const char* COMMAND_PREFIX;
 extern const char* PROGRESS_PREFIX;
 
+class ThreadLocalPointer;
+
+// What a background thread reported while its output was captured.
+// See Connection::BeginCapture().
+struct ConnectionCapture
+{
+	std::string output;  // lines for Unity
+	Metrics metrics;
+	Tracer tracer;       // never enabled. Only the main thread is traced.
+};
+
 class Connection
 {
 public:
@@ -42,6 +55,32 @@ public:
 	// Get the log stream
 	LogStream& Log();
 
+	// Timing and traffic metrics of the commands handled
+	Metrics& GetMetrics();
+
+	// Optional trace of where the time is spent
+	Tracer& GetTracer();
+
+	// Output for Unity, metrics and tracing of work done on the calling thread
+	// are kept aside until EndCapture(). This lets a background thread use the
+	// connection while the main thread is serving Unity. The work shows up in
+	// the metrics as a command with the given name or, without a name, as part
+	// of the Unity command it is sent with.
+	void BeginCapture(const std::string& name);
+
+	// Returns the captured output which the caller must delete
+	ConnectionCapture* EndCapture();
+
+	// Send output captured on another thread as part of the current response
+	void SendCaptured(const ConnectionCapture& capture);
+
+	// Keep a copy in target of what the main thread sends for the rest of the
+	// current response, up to but not including the end of response. NULL stops.
+	void RecordResponse(std::string* target);
+
+	// Send a response recorded earlier again. The caller ends the response.
+	void Resend(const std::string& recorded);
+
 	// Get the raw pipe to Unity. 
 	// Make sure IsConnected() is true before using.
 	//	Pipe& GetPipe();
@@ -56,6 +95,9 @@ public:
 	std::string& ReadLine(std::string& target);
 	std::string& PeekLine(std::string& target);
 
+	// True if Unity has sent something that has not been read yet
+	bool HasInput() const;
+
 	template <typename T>
 	Connection& DataLine(const T& msg, MessageArea ma = MAGeneral)
 	{
@@ -94,6 +136,10 @@ public:
 	// Params: -1 means not specified
 	Connection& Progress(int pct = -1, time_t timeSoFar = -1, const std::string& message = "", MessageArea ma = MAGeneral);
 
+	// Least time between progress updates sent by a ProgressReporter. 0 sends all.
+	void SetProgressInterval(Microseconds interval) { m_ProgressInterval = interval; }
+	Microseconds GetProgressInterval() const { return m_ProgressInterval; }
+
 	Connection& operator<<(const std::vector<std::string>& v);
 
 private:
@@ -104,9 +150,14 @@ private:
 	Connection& Write(const T& v, LogWriter& log)
 	{
 		log << v;
-		m_Pipe->Write(v);
+		Output(ToString(v));
 		return *this;
 	}
+
+	// Write to the pipe or the capture of the calling thread
+	void Output(const std::string& v);
+	void Output(const char* v);
+	ConnectionCapture* GetCapture() const;
 	
 	// Encode newlines in strings
 	Connection& Write(const std::string& v, LogWriter& log);
@@ -135,6 +186,12 @@ private:
 
 	LogStream* m_Log;
 	Pipe* m_Pipe;
+	Metrics m_Metrics;
+	Tracer m_Tracer;
+	unsigned long long m_CommandStartBytesWritten;
+	ThreadLocalPointer* m_Capture;
+	std::string* m_Recording;
+	Microseconds m_ProgressInterval;
 };
 
 
@@ -145,6 +202,9 @@ Connection& operator<<(Connection& p, const T& v);
 template <typename T>
 Connection& operator<<(Connection& p, const std::vector<T>& v)
 {
+	TraceScope trace(p.GetTracer(), "encode", "pipe");
+	p.GetTracer().AddArg("count", v.size());
+	p.GetTracer().AddRootArg("outputCount", v.size());
 	p.DataLine(v.size());
 	for (typename std::vector<T>::const_iterator i = v.begin(); i != v.end(); ++i)
 		p << *i;
@@ -154,6 +214,9 @@ Connection& operator<<(Connection& p, const std::vector<T>& v)
 template <typename T>
 Connection& operator<<(Connection& p, const std::set<T>& v)
 {
+	TraceScope trace(p.GetTracer(), "encode", "pipe");
+	p.GetTracer().AddArg("count", v.size());
+	p.GetTracer().AddRootArg("outputCount", v.size());
 	p.DataLine(v.size());
 	for (typename std::set<T>::const_iterator i = v.begin(); i != v.end(); ++i)
 		p << *i;
@@ -163,6 +226,7 @@ Connection& operator<<(Connection& p, const std::set<T>& v)
 template <typename T>
 Connection& operator>>(Connection& conn, std::vector<T>& v)
 {
+	TraceScope trace(conn.GetTracer(), "decode", "pipe");
 	std::string line;
 	conn.ReadLine(line);
 	int count = atoi(line.c_str());
@@ -186,12 +250,15 @@ Connection& operator>>(Connection& conn, std::vector<T>& v)
 		}
 		conn.ReadLine(line);
 	}
+	conn.GetTracer().AddArg("count", v.size());
+	conn.GetTracer().AddRootArg("inputCount", v.size());
 	return conn;
 }
 
 template <typename T>
 Connection& operator>>(Connection& conn, std::set<T>& v)
 {
+	TraceScope trace(conn.GetTracer(), "decode", "pipe");
 	std::string line;
 	conn.ReadLine(line);
 	int count = atoi(line.c_str());
@@ -215,5 +282,7 @@ Connection& operator>>(Connection& conn, std::set<T>& v)
 		}
 		conn.ReadLine(line);
 	}
+	conn.GetTracer().AddArg("count", v.size());
+	conn.GetTracer().AddRootArg("inputCount", v.size());
 	return conn;
 }
@@ -37,7 +37,7 @@ template <template<class> class CommandTmpl, class Session>
 bool Dispatch(Connection& conn, Session& session, 
 			  UnityCommand cmd, const CommandArgs& args)
 {
-	conn.Log().Info() << Join(args, " ") << Endl;
+	INFO_LOG(conn.Log()) << Join(args, " ") << Endl;
 
 	switch (cmd)
 	{
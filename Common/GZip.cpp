@@ -0,0 +1,233 @@
+#include "GZip.h"
+#include <fstream>
+#include <vector>
+
+const int WINDOW_SIZE = 32768;
+const int WINDOW_MASK = WINDOW_SIZE - 1;
+const int HASH_BITS = 15;
+const int HASH_SIZE = 1 << HASH_BITS;
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+const int MAX_CHAIN = 32; // match candidates to try per position
+
+static const unsigned short s_LengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char s_LengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short s_DistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char s_DistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+unsigned long CRC32(unsigned long crc, const unsigned char* data, size_t length)
+{
+	static unsigned long table[256];
+	static bool tableReady = false;
+	if (!tableReady)
+	{
+		for (unsigned long n = 0; n < 256; ++n)
+		{
+			unsigned long c = n;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = crc ^ 0xFFFFFFFFUL;
+	for (size_t i = 0; i < length; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return (crc ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+}
+
+// Deflate writes bits starting with the least significant one
+class BitWriter
+{
+public:
+	BitWriter(std::string& out) : m_Out(out), m_Bits(0), m_Count(0) {}
+
+	void Write(unsigned int value, int count)
+	{
+		m_Bits |= (unsigned long)value << m_Count;
+		m_Count += count;
+		while (m_Count >= 8)
+		{
+			m_Out += (char)(m_Bits & 0xFF);
+			m_Bits >>= 8;
+			m_Count -= 8;
+		}
+	}
+
+	// Huffman codes are stored starting with the most significant bit
+	void WriteCode(unsigned int code, int length)
+	{
+		unsigned int reversed = 0;
+		for (int i = 0; i < length; ++i)
+		{
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		Write(reversed, length);
+	}
+
+	void Finish()
+	{
+		if (m_Count > 0)
+			m_Out += (char)(m_Bits & 0xFF);
+		m_Bits = 0;
+		m_Count = 0;
+	}
+
+private:
+	std::string& m_Out;
+	unsigned long m_Bits;
+	int m_Count;
+};
+
+static void WriteLiteral(BitWriter& w, unsigned int v)
+{
+	// Fixed literal/length code of RFC 1951 3.2.6
+	if (v < 144)
+		w.WriteCode(0x30 + v, 8);
+	else if (v < 256)
+		w.WriteCode(0x190 + v - 144, 9);
+	else if (v < 280)
+		w.WriteCode(v - 256, 7);
+	else
+		w.WriteCode(0xC0 + v - 280, 8);
+}
+
+static void WriteMatch(BitWriter& w, int length, int distance)
+{
+	int code = 28;
+	while (s_LengthBase[code] > length)
+		--code;
+	WriteLiteral(w, 257 + code);
+	w.Write(length - s_LengthBase[code], s_LengthExtra[code]);
+
+	code = 29;
+	while (s_DistanceBase[code] > distance)
+		--code;
+	w.WriteCode(code, 5);
+	w.Write(distance - s_DistanceBase[code], s_DistanceExtra[code]);
+}
+
+static inline unsigned int Hash(const unsigned char* p)
+{
+	return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (HASH_SIZE - 1);
+}
+
+static void Deflate(const unsigned char* data, int size, std::string& out)
+{
+	BitWriter w(out);
+	w.Write(1, 1); // final block
+	w.Write(1, 2); // fixed Huffman codes
+
+	// Most recent position for each hash and the previous position with the same hash
+	std::vector<int> head(HASH_SIZE, -1);
+	std::vector<int> prev(WINDOW_SIZE, -1);
+
+	int pos = 0;
+	while (pos < size)
+	{
+		int bestLength = 0;
+		int bestDistance = 0;
+		if (pos + MIN_MATCH <= size)
+		{
+			unsigned int h = Hash(data + pos);
+			int candidate = head[h];
+			int maxLength = size - pos < MAX_MATCH ? size - pos : MAX_MATCH;
+			for (int chain = 0; candidate >= 0 && pos - candidate <= WINDOW_SIZE && chain < MAX_CHAIN; ++chain)
+			{
+				if (data[candidate + bestLength] == data[pos + bestLength])
+				{
+					int len = 0;
+					while (len < maxLength && data[candidate + len] == data[pos + len])
+						++len;
+					if (len > bestLength)
+					{
+						bestLength = len;
+						bestDistance = pos - candidate;
+						if (len == maxLength)
+							break;
+					}
+				}
+				candidate = prev[candidate & WINDOW_MASK];
+			}
+		}
+
+		int advance = 1;
+		if (bestLength >= MIN_MATCH)
+		{
+			WriteMatch(w, bestLength, bestDistance);
+			advance = bestLength;
+		}
+		else
+		{
+			WriteLiteral(w, data[pos]);
+		}
+
+		// Index every position we pass so later matches can refer to them
+		for (int end = pos + advance; pos < end; ++pos)
+		{
+			if (pos + MIN_MATCH <= size)
+			{
+				unsigned int h = Hash(data + pos);
+				prev[pos & WINDOW_MASK] = head[h];
+				head[h] = pos;
+			}
+		}
+	}
+
+	WriteLiteral(w, 256); // end of block
+	w.Finish();
+}
+
+static void AppendUInt32(std::string& out, unsigned long v)
+{
+	for (int i = 0; i < 4; ++i)
+		out += (char)((v >> (8 * i)) & 0xFF);
+}
+
+void GZipCompress(const std::string& data, std::string& out)
+{
+	static const char header[10] = { (char)0x1f, (char)0x8b, 8, 0, 0, 0, 0, 0, 0, (char)0xff };
+	out.append(header, sizeof(header));
+
+	const unsigned char* bytes = (const unsigned char*)data.data();
+	Deflate(bytes, (int)data.size(), out);
+
+	AppendUInt32(out, CRC32(0, bytes, data.size()));
+	AppendUInt32(out, (unsigned long)data.size());
+}
+
+bool GZipFile(const std::string& sourcePath, const std::string& targetPath)
+{
+	std::ifstream in(sourcePath.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open())
+		return false;
+
+	std::string data;
+	char buf[64 * 1024];
+	while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+		data.append(buf, (size_t)in.gcount());
+	if (in.bad())
+		return false;
+	in.close();
+
+	std::string compressed;
+	compressed.reserve(data.size() / 3);
+	GZipCompress(data, compressed);
+
+	std::ofstream out(targetPath.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	if (!out.is_open())
+		return false;
+	out.write(compressed.data(), compressed.size());
+	out.close();
+	return !out.fail();
+}
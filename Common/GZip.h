@@ -0,0 +1,14 @@
+/*
+ * Minimal gzip (RFC 1952) writer using deflate with fixed Huffman codes.
+ * Good enough for archiving text like log files without depending on zlib.
+ */
+#pragma once
+#include <string>
+
+unsigned long CRC32(unsigned long crc, const unsigned char* data, size_t length);
+
+// Compress data into a complete gzip member appended to out
+void GZipCompress(const std::string& data, std::string& out);
+
+// Compress sourcePath into targetPath. Returns false on I/O errors.
+bool GZipFile(const std::string& sourcePath, const std::string& targetPath);
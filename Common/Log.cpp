@@ -1,10 +1,389 @@
 #include "Log.h"
+#include "Thread.h"
+#include "FileSystem.h"
+#include "GZip.h"
+#include "Utility.h"
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
 
+// Number of records the queue can hold. Must be a power of two.
+const long LOG_QUEUE_SIZE = 4096;
 
-LogWriter::LogWriter(LogStream& stream, bool isOn) : m_Stream(stream), m_On(isOn) 
+// Wake up the background writer every time this many records have been queued
+const long LOG_QUEUE_WAKE_INTERVAL = LOG_QUEUE_SIZE / 4;
+
+// How long the background writer sleeps when nobody wakes it up
+const int LOG_WRITE_INTERVAL_MS = 50;
+
+// Record buffers kept for reuse by threads other than the main one
+const size_t LOG_FREE_BUFFERS = 8;
+
+// Positions are compared as wrapping counters
+static long Distance(long from, long to)
+{
+	return (long)((unsigned long)to - (unsigned long)from);
+}
+
+// Bounded multi producer single consumer queue of log records (after Dmitry
+// Vyukov's bounded MPMC queue) plus the background thread consuming it.
+// The background thread also rotates the log file. Archives are compressed on
+// a thread of their own.
+class LogQueue
+{
+public:
+	LogQueue(LogStream& log, const std::string& path, size_t maxSize, int generations);
+	~LogQueue();
+
+	bool IsRunning() const { return m_Thread.IsStarted(); }
+
+	// Returns false if the queue is full. On success ticket is the position of the record.
+	bool TryEnqueue(std::string& record, long& ticket);
+
+	// Wait until the record at ticket is on disk
+	void WaitWritten(long ticket);
+	void Wake() { m_WorkEvent.Set(); }
+	void Stop();
+
+	// Record being written on the calling thread. FindPending() returns NULL
+	// instead of making one.
+	std::ostringstream& Pending();
+	std::ostringstream* FindPending() const;
+
+	// Done with the record of the calling thread
+	void ReleasePending();
+
+	void AddDropped() { AtomicIncrement(&m_Dropped); }
+
+	// Used when the background thread is not running
+	void WriteNow(const std::string& data);
+
+private:
+	struct Cell
+	{
+		volatile long sequence;
+		std::string record;
+	};
+
+	bool TryDequeue(std::string& record);
+	void Drain();
+	void Write(const std::string& data);
+	void Rotate();
+	std::string GenerationPath(int generation) const;
+	static void ThreadMain(void* userData);
+	static void CompressMain(void* userData);
+
+	LogStream& m_Log;
+	Cell* m_Cells;
+	volatile long m_EnqueuePos;
+	long m_DequeuePos;
+	volatile long m_WrittenPos;
+	volatile long m_Dropped;
+	volatile long m_Stop;
+
+	Thread m_Thread;
+	Event m_WorkEvent;
+	Event m_WrittenEvent;
+	Mutex m_WriteMutex;
+
+	std::string m_Path;
+	size_t m_MaxSize;
+	int m_Generations;
+	size_t m_Size;
+	Thread m_CompressThread;
+
+	ThreadLocalPointer m_PendingPointer;
+	std::ostringstream* m_MainPending;
+	Mutex m_PendingMutex;
+	std::vector<std::ostringstream*> m_FreePending;
+};
+
+LogQueue::LogQueue(LogStream& log, const std::string& path, size_t maxSize, int generations)
+	: m_Log(log), m_EnqueuePos(0), m_DequeuePos(0), m_WrittenPos(0), m_Dropped(0), m_Stop(0),
+	  m_Path(path), m_MaxSize(maxSize), m_Generations(generations), m_Size(0), m_MainPending(NULL)
+{
+	if (m_MaxSize && PathExists(m_Path))
+		m_Size = GetFileLength(m_Path);
+
+	m_Cells = new Cell[LOG_QUEUE_SIZE];
+	for (long i = 0; i < LOG_QUEUE_SIZE; ++i)
+		m_Cells[i].sequence = i;
+	m_Thread.Start(&LogQueue::ThreadMain, this);
+}
+
+LogQueue::~LogQueue()
+{
+	Stop();
+	for (std::vector<std::ostringstream*>::iterator i = m_FreePending.begin(); i != m_FreePending.end(); ++i)
+		delete *i;
+	delete m_MainPending;
+	delete[] m_Cells;
+}
+
+std::ostringstream& LogQueue::Pending()
+{
+	std::ostringstream* pending = FindPending();
+	if (pending == NULL)
+	{
+		{
+			MutexLock lock(m_PendingMutex);
+			if (!m_FreePending.empty())
+			{
+				pending = m_FreePending.back();
+				m_FreePending.pop_back();
+			}
+		}
+		if (pending == NULL)
+			pending = new std::ostringstream();
+		m_PendingPointer.Set(pending);
+		if (Thread::IsMainThread())
+			m_MainPending = pending;
+	}
+	return *pending;
+}
+
+std::ostringstream* LogQueue::FindPending() const
+{
+	return static_cast<std::ostringstream*>(m_PendingPointer.Get());
+}
+
+// Threads other than the main one come and go with the operations they run.
+// Their buffer is handed back once a record is complete rather than kept
+// until the process exits.
+void LogQueue::ReleasePending()
+{
+	std::ostringstream* pending = FindPending();
+	if (pending == NULL || pending == m_MainPending)
+		return;
+
+	m_PendingPointer.Set(NULL);
+	pending->str(std::string());
+	MutexLock lock(m_PendingMutex);
+	if (m_FreePending.size() < LOG_FREE_BUFFERS)
+		m_FreePending.push_back(pending);
+	else
+		delete pending;
+}
+
+bool LogQueue::TryEnqueue(std::string& record, long& ticket)
+{
+	long pos = AtomicLoad(&m_EnqueuePos);
+	for (;;)
+	{
+		Cell& cell = m_Cells[pos & (LOG_QUEUE_SIZE - 1)];
+		long dif = Distance(pos, AtomicLoad(&cell.sequence));
+		if (dif == 0)
+		{
+			long next = Distance(-1, pos);
+			long seen = AtomicCompareExchange(&m_EnqueuePos, next, pos);
+			if (seen == pos)
+			{
+				cell.record.swap(record);
+				AtomicStore(&cell.sequence, next);
+				ticket = pos;
+				return true;
+			}
+			pos = seen;
+		}
+		else if (dif < 0)
+		{
+			return false; // full
+		}
+		else
+		{
+			pos = AtomicLoad(&m_EnqueuePos);
+		}
+	}
+}
+
+bool LogQueue::TryDequeue(std::string& record)
+{
+	Cell& cell = m_Cells[m_DequeuePos & (LOG_QUEUE_SIZE - 1)];
+	if (Distance(Distance(-1, m_DequeuePos), AtomicLoad(&cell.sequence)) < 0)
+		return false; // empty or not yet published
+
+	record.swap(cell.record);
+	cell.record.clear();
+	AtomicStore(&cell.sequence, Distance(-LOG_QUEUE_SIZE, m_DequeuePos));
+	m_DequeuePos = Distance(-1, m_DequeuePos);
+	return true;
+}
+
+void LogQueue::Drain()
+{
+	std::string batch;
+	std::string record;
+	while (TryDequeue(record))
+		batch += record;
+
+	long dropped = AtomicLoad(&m_Dropped);
+	if (dropped)
+	{
+		AtomicAdd(&m_Dropped, -dropped);
+		std::stringstream ss;
+		ss << "[" << dropped << " log records dropped because the log queue was full]\n";
+		batch += ss.str();
+	}
+
+	if (!batch.empty())
+	{
+		MutexLock lock(m_WriteMutex);
+		Write(batch);
+	}
+
+	AtomicStore(&m_WrittenPos, m_DequeuePos);
+	m_WrittenEvent.Set();
+}
+
+void LogQueue::WriteNow(const std::string& data)
+{
+	MutexLock lock(m_WriteMutex);
+	Write(data);
+}
+
+void LogQueue::Write(const std::string& data)
+{
+	if (m_MaxSize && m_Size > 0 && m_Size + data.length() > m_MaxSize)
+		Rotate();
+
+	m_Log.m_Stream.write(data.data(), data.length());
+	m_Log.m_Stream.flush();
+	m_Size += data.length();
+}
+
+std::string LogQueue::GenerationPath(int generation) const
+{
+	return m_Path + "." + IntToString(generation);
+}
+
+// Shift the archives to make room for the current file as generation 1 and
+// start a new file. Generation 1 is compressed in the background.
+void LogQueue::Rotate()
+{
+	m_Log.m_Stream.close();
+
+	// The previous archive is normally compressed long ago
+	m_CompressThread.Join();
+
+	if (m_Generations <= 0)
+	{
+		m_Log.m_Stream.open(m_Path.c_str(), std::ios_base::out | std::ios_base::trunc);
+		m_Size = 0;
+		return;
+	}
+
+	std::string oldest = GenerationPath(m_Generations) + ".gz";
+	if (PathExists(oldest))
+		DeleteRecursive(oldest);
+	for (int i = m_Generations - 1; i >= 1; --i)
+	{
+		std::string from = GenerationPath(i) + ".gz";
+		if (PathExists(from))
+			MoveAFile(from, GenerationPath(i + 1) + ".gz");
+	}
+
+	// Left over if the process exited while compressing
+	std::string first = GenerationPath(1);
+	if (PathExists(first))
+		DeleteRecursive(first);
+
+	bool moved = MoveAFile(m_Path, first);
+	m_Log.m_Stream.open(m_Path.c_str(), moved ? std::ios_base::app : std::ios_base::out | std::ios_base::trunc);
+	m_Size = 0;
+
+	if (moved)
+		m_CompressThread.Start(&LogQueue::CompressMain, this);
+}
+
+void LogQueue::CompressMain(void* userData)
+{
+	LogQueue* queue = static_cast<LogQueue*>(userData);
+	std::string source = queue->GenerationPath(1);
+	std::string target = source + ".gz";
+	std::string partial = target + ".tmp";
+
+	// Only replace the archive once it is complete
+	if (GZipFile(source, partial) && MoveAFile(partial, target))
+		DeleteRecursive(source);
+	else if (PathExists(partial))
+		DeleteRecursive(partial);
+}
+
+void LogQueue::WaitWritten(long ticket)
+{
+	while (IsRunning() && Distance(ticket, AtomicLoad(&m_WrittenPos)) <= 0)
+	{
+		m_WorkEvent.Set();
+		m_WrittenEvent.Wait(10);
+	}
+}
+
+void LogQueue::Stop()
+{
+	if (!IsRunning())
+		return;
+	AtomicStore(&m_Stop, 1);
+	m_WorkEvent.Set();
+	m_Thread.Join();
+	m_CompressThread.Join();
+}
+
+void LogQueue::ThreadMain(void* userData)
+{
+	LogQueue* queue = static_cast<LogQueue*>(userData);
+	for (;;)
+	{
+		bool stop = AtomicLoad(&queue->m_Stop) != 0;
+		if (!stop)
+			queue->m_WorkEvent.Wait(LOG_WRITE_INTERVAL_MS);
+		queue->Drain();
+		if (stop)
+			break;
+	}
+}
+
+
+// Streams still alive at exit are shut down so that nothing logged is lost
+static Mutex s_StreamsMutex;
+static std::vector<LogStream*> s_Streams;
+
+static void ShutdownStreamsAtExit()
+{
+	MutexLock lock(s_StreamsMutex);
+	for (std::vector<LogStream*>::iterator i = s_Streams.begin(); i != s_Streams.end(); ++i)
+		(*i)->Shutdown();
+}
+
+static void RegisterStream(LogStream* stream)
+{
+	static bool registered = false;
+	MutexLock lock(s_StreamsMutex);
+	if (!registered)
+	{
+		atexit(ShutdownStreamsAtExit);
+		registered = true;
+	}
+	s_Streams.push_back(stream);
+}
+
+static void UnregisterStream(LogStream* stream)
+{
+	MutexLock lock(s_StreamsMutex);
+	for (std::vector<LogStream*>::iterator i = s_Streams.begin(); i != s_Streams.end(); ++i)
+	{
+		if (*i == stream)
+		{
+			s_Streams.erase(i);
+			break;
+		}
+	}
+}
+
+
+LogWriter::LogWriter(LogStream& stream, bool isOn, bool isSync) : m_Stream(stream), m_On(isOn), m_Sync(isSync)
 {
 }
-	
+
 LogWriter& Flush(LogWriter& w)
 {
 	w.Flush();
@@ -19,12 +398,16 @@ LogWriter& Endl(LogWriter& w)
 }
 
 
-LogStream::LogStream(const std::string& path, LogLevel level) 
+LogStream::LogStream(const std::string& path, LogLevel level, size_t maxSize, int generations)
 	: m_LogLevel(level),
-	  m_Stream(path.c_str(), std::ios_base::app), 
-	  m_OnWriter(Self(), true), 
-	  m_OffWriter(Self(), false)
+	  m_Stream(path.c_str(), std::ios_base::app),
+	  m_Queue(NULL),
+	  m_OnWriter(Self(), true),
+	  m_OffWriter(Self(), false),
+	  m_FatalWriter(Self(), true, true)
 {
+	m_Queue = new LogQueue(Self(), path, maxSize, generations);
+	RegisterStream(this);
 }
 
 LogStream& LogStream::Self(void)
@@ -35,46 +418,117 @@ LogStream& LogStream::Self(void)
 
 LogStream::~LogStream()
 {
+	UnregisterStream(this);
+	Shutdown();
+	delete m_Queue;
 	m_Stream.flush();
 	m_Stream.close();
 }
 
-void LogStream::SetLogLevel(LogLevel l) 
-{ 
-	m_LogLevel = l; 
+void LogStream::SetLogLevel(LogLevel l)
+{
+	m_LogLevel = l;
+}
+
+LogLevel LogStream::GetLogLevel() const
+{
+	return m_LogLevel;
+}
+
+LogWriter& LogStream::Debug()
+{
+	return IsEnabled(LOG_DEBUG) ? m_OnWriter : m_OffWriter;
+}
+
+LogWriter& LogStream::Info()
+{
+	return IsEnabled(LOG_INFO) ? m_OnWriter : m_OffWriter;
 }
 
-LogLevel LogStream::GetLogLevel() const 
-{ 
-	return m_LogLevel; 
+LogWriter& LogStream::Notice()
+{
+	return IsEnabled(LOG_NOTICE) ? m_OnWriter : m_OffWriter;
 }
 
-LogWriter& LogStream::Debug() 
-{ 
-	return m_LogLevel <= LOG_DEBUG ? m_OnWriter : m_OffWriter; 
+LogWriter& LogStream::Fatal()
+{
+	return IsEnabled(LOG_FATAL) ? m_FatalWriter : m_OffWriter;
 }
 
-LogWriter& LogStream::Info() 
-{ 
-	return m_LogLevel <= LOG_INFO ? m_OnWriter : m_OffWriter; 
+std::ostream& LogStream::Pending()
+{
+	return m_Queue->Pending();
 }
 
-LogWriter& LogStream::Notice() 
-{ 
-	return m_LogLevel <= LOG_NOTICE ? m_OnWriter : m_OffWriter; 
+void LogStream::Push(std::string& record, bool sync)
+{
+	if (!m_Queue->IsRunning())
+	{
+		m_Queue->WriteNow(record);
+		return;
+	}
+
+	long ticket = 0;
+	if (m_Queue->TryEnqueue(record, ticket))
+	{
+		if (sync)
+			m_Queue->WaitWritten(ticket);
+		else if ((ticket & (LOG_QUEUE_WAKE_INTERVAL - 1)) == 0)
+			m_Queue->Wake(); // don't wait for the timer when records come in fast
+		return;
+	}
+
+	if (!sync)
+	{
+		m_Queue->AddDropped();
+		m_Queue->Wake();
+		return;
+	}
+
+	// Records that must not be lost wait for room in the queue
+	do
+	{
+		m_Queue->Wake();
+		SleepMilliseconds(1);
+	}
+	while (!m_Queue->TryEnqueue(record, ticket));
+	m_Queue->WaitWritten(ticket);
 }
 
-LogWriter& LogStream::Fatal() 
-{ 
-	return m_LogLevel <= LOG_FATAL ? m_OnWriter : m_OffWriter; 
+LogStream& LogStream::Flush()
+{
+	std::ostringstream* pending = m_Queue->FindPending();
+	if (pending != NULL && pending->tellp() > 0)
+	{
+		std::string record = pending->str();
+		pending->str(std::string());
+		m_Queue->ReleasePending();
+		Push(record, false);
+	}
+	return *this;
 }
 
-LogStream& LogStream::Flush() 
+LogStream& LogStream::Sync()
 {
-	m_Stream << std::flush; 
+	std::string record;
+	std::ostringstream* pending = m_Queue->FindPending();
+	if (pending != NULL)
+	{
+		record = pending->str();
+		pending->str(std::string());
+		m_Queue->ReleasePending();
+	}
+	// An empty record still tells us when everything before it has been written
+	Push(record, true);
 	return *this;
 }
 
+void LogStream::Shutdown()
+{
+	Sync();
+	m_Queue->Stop();
+}
+
 LogWriter& operator<<(LogWriter& w, LogWriter& (*pf)(LogWriter&))
 {
 	return pf(w);
@@ -85,12 +539,18 @@ LogStream& operator<<(LogStream& w, LogStream& (*pf)(LogStream&))
 	return pf(w);
 }
 
-LogWriter& LogWriter::Flush() 
+LogWriter& LogWriter::Flush()
 {
-	if (m_On) m_Stream.Flush();
+	if (m_On)
+	{
+		if (m_Sync)
+			m_Stream.Sync();
+		else
+			m_Stream.Flush();
+	}
 	return *this;
 }
-	
+
 LogStream& Flush(LogStream& w)
 {
 	w.Flush();
@@ -103,4 +563,3 @@ LogStream& Endl(LogStream& w)
 	w.Flush();
 	return w;
 }
-
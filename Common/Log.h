@@ -1,5 +1,7 @@
 #pragma once
 #include <fstream>
+#include <ostream>
+#include <string>
 
 // Log levels. 
 // Lower levels are included in highers levels automatically.
@@ -11,6 +13,15 @@ enum LogLevel
 	LOG_FATAL,  // errors and exceptions
 };
 
+// Records below this level are compiled out. Release builds drop debug logging.
+#if !defined(LOG_MIN_LEVEL)
+#if defined(NDEBUG)
+#define LOG_MIN_LEVEL LOG_INFO
+#else
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+#endif
+
 
 class LogStream;
 
@@ -20,13 +31,15 @@ class LogStream;
 class LogWriter
 {
 public:
-	LogWriter(LogStream& stream, bool isOn);
+	LogWriter(LogStream& stream, bool isOn, bool isSync = false);
 	LogWriter& Flush();
 	template<typename T> LogWriter& Write(const T& v);
+	bool IsOn() const { return m_On; }
 
 private:
 	LogStream& m_Stream;
 	bool m_On;
+	bool m_Sync; // flushing waits for the log to be on disk
 };
 
 template<typename T>
@@ -47,10 +60,21 @@ LogWriter& operator<<(LogWriter& w, LogWriter& (*pf)(LogWriter&));
 LogWriter& Flush(LogWriter& w);
 LogWriter& Endl(LogWriter& w);
 
+class LogQueue;
+
+// Log records are formatted on the calling thread and handed to a background
+// thread through a bounded lock free queue. The background thread writes them
+// to disk in batches.
+// If the queue is full records are dropped and the number of dropped records is
+// logged once there is room again. Fatal records are never dropped and are on
+// disk when the Fatal() writer has been flushed. Everything logged is written
+// before the process exits.
+// Given a maxSize the file is rotated while running before it grows beyond it.
+// The last generations are kept as gzip archives path.1.gz (newest) to path.N.gz.
 class LogStream
 {		
 public:
-	LogStream(const std::string& path, LogLevel level = LOG_NOTICE);
+	LogStream(const std::string& path, LogLevel level = LOG_NOTICE, size_t maxSize = 0, int generations = 0);
 	~LogStream();
 	
 	LogStream& Self(void);
@@ -58,26 +82,44 @@ public:
 	void SetLogLevel(LogLevel l);
 	LogLevel GetLogLevel() const;
 
+	// True if records of the level are written
+	bool IsEnabled(LogLevel l) const { return l >= LOG_MIN_LEVEL && l >= m_LogLevel; }
+
 	LogWriter& Debug();
 	LogWriter& Info();
 	LogWriter& Notice();
 	LogWriter& Fatal();
 
+	// Hand the text written on this thread to the background writer
 	LogStream& Flush();
 
+	// Flush and wait until everything logged so far is on disk
+	LogStream& Sync();
+
+	// Sync and stop the background writer. Later records are written synchronously.
+	void Shutdown();
+
 	template<typename T> LogStream& Write(const T& v);
 private:
+	friend class LogQueue;
+
+	// Text written on the calling thread since its last flush
+	std::ostream& Pending();
+	void Push(std::string& record, bool sync);
+
 	LogLevel m_LogLevel;
 	std::ofstream m_Stream;
-	LogWriter m_OnWriter;  // write logs to file
-	LogWriter m_OffWriter; // throw away logs
+	LogQueue* m_Queue;
+	LogWriter m_OnWriter;    // write logs to file
+	LogWriter m_OffWriter;   // throw away logs
+	LogWriter m_FatalWriter; // write logs to file and wait for them on flush
 };
 
 
 template<typename T>
 LogStream& LogStream::Write(const T& v)
 {
-	m_Stream << v;
+	Pending() << v;
 	return *this;
 }
 
@@ -91,3 +133,13 @@ LogStream& operator<<(LogStream& w, LogStream& (*pf)(LogStream&));
 LogStream& Flush(LogStream& w);
 LogStream& Endl(LogStream& w);
 
+// Log with arguments that are only evaluated when the level is enabled e.g.
+//   DEBUG_LOG(conn.Log()) << ExpensiveToFormat() << Endl;
+// A loop run at most once rather than an if so that an else after the macro
+// in an unbraced if cannot bind to it.
+#define LOG_AT_LEVEL(log, level, writer) \
+	for (bool logAtLevelOn = (log).IsEnabled(level); logAtLevelOn; logAtLevelOn = false) (log).writer()
+#define DEBUG_LOG(log) LOG_AT_LEVEL(log, LOG_DEBUG, Debug)
+#define INFO_LOG(log) LOG_AT_LEVEL(log, LOG_INFO, Info)
+#define NOTICE_LOG(log) LOG_AT_LEVEL(log, LOG_NOTICE, Notice)
+
@@ -0,0 +1,427 @@
+#include "Metrics.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WINDOWS)
+#include <windows.h>
+
+Microseconds GetMonotonicTime()
+{
+	static LARGE_INTEGER freq = { 0 };
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	// Split to avoid overflowing when multiplying large counter values
+	return (Microseconds)(now.QuadPart / freq.QuadPart) * 1000000 +
+		(Microseconds)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+}
+
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+
+Microseconds GetMonotonicTime()
+{
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if (timebase.denom == 0)
+		mach_timebase_info(&timebase);
+	return (Microseconds)(mach_absolute_time() * timebase.numer / timebase.denom / 1000);
+}
+
+#else
+#include <time.h>
+
+Microseconds GetMonotonicTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Microseconds)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
+
+LatencyHistogram::LatencyHistogram()
+	: m_Count(0), m_Total(0), m_Min(0), m_Max(0)
+{
+	for (int i = 0; i < kBucketCount; ++i)
+		m_Buckets[i] = 0;
+}
+
+void LatencyHistogram::Add(Microseconds t)
+{
+	int bucket = 0;
+	for (Microseconds v = t >> 1; v && bucket < kBucketCount - 1; v >>= 1)
+		++bucket;
+
+	++m_Buckets[bucket];
+	if (m_Count == 0 || t < m_Min)
+		m_Min = t;
+	if (t > m_Max)
+		m_Max = t;
+	++m_Count;
+	m_Total += t;
+}
+
+void LatencyHistogram::Add(const LatencyHistogram& other)
+{
+	if (other.m_Count == 0)
+		return;
+
+	for (int i = 0; i < kBucketCount; ++i)
+		m_Buckets[i] += other.m_Buckets[i];
+	if (m_Count == 0 || other.m_Min < m_Min)
+		m_Min = other.m_Min;
+	if (other.m_Max > m_Max)
+		m_Max = other.m_Max;
+	m_Count += other.m_Count;
+	m_Total += other.m_Total;
+}
+
+Microseconds LatencyHistogram::GetBucketUpperBound(int i)
+{
+	return ((Microseconds)1 << (i + 1)) - 1;
+}
+
+Microseconds LatencyHistogram::GetPercentile(int pct) const
+{
+	if (m_Count == 0)
+		return 0;
+
+	unsigned int target = (unsigned int)(((unsigned long long)m_Count * pct + 99) / 100);
+	if (target == 0)
+		target = 1;
+
+	unsigned int seen = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		seen += m_Buckets[i];
+		if (seen >= target)
+		{
+			Microseconds bound = GetBucketUpperBound(i);
+			return bound < m_Max ? bound : m_Max;
+		}
+	}
+	return m_Max;
+}
+
+CommandCounters::CommandCounters()
+	: roundTrips(0), records(0), bytesReceived(0), bytesWritten(0), reconnects(0), handshakeTime(0), relogins(0), loginTime(0),
+	  trackedCommands(0), serverLapse(0), serverLockWait(0), rpcWait(0),
+	  filesTransferred(0), bytesTransferred(0), transferTime(0)
+{
+}
+
+CommandCounters& CommandCounters::operator+=(const CommandCounters& o)
+{
+	roundTrips += o.roundTrips;
+	records += o.records;
+	bytesReceived += o.bytesReceived;
+	bytesWritten += o.bytesWritten;
+	reconnects += o.reconnects;
+	handshakeTime += o.handshakeTime;
+	relogins += o.relogins;
+	loginTime += o.loginTime;
+	trackedCommands += o.trackedCommands;
+	serverLapse += o.serverLapse;
+	serverLockWait += o.serverLockWait;
+	rpcWait += o.rpcWait;
+	filesTransferred += o.filesTransferred;
+	bytesTransferred += o.bytesTransferred;
+	transferTime += o.transferTime;
+	return *this;
+}
+
+CommandCounters CommandCounters::operator-(const CommandCounters& o) const
+{
+	CommandCounters r;
+	r.roundTrips = roundTrips - o.roundTrips;
+	r.records = records - o.records;
+	r.bytesReceived = bytesReceived - o.bytesReceived;
+	r.bytesWritten = bytesWritten - o.bytesWritten;
+	r.reconnects = reconnects - o.reconnects;
+	r.handshakeTime = handshakeTime - o.handshakeTime;
+	r.relogins = relogins - o.relogins;
+	r.loginTime = loginTime - o.loginTime;
+	r.trackedCommands = trackedCommands - o.trackedCommands;
+	r.serverLapse = serverLapse - o.serverLapse;
+	r.serverLockWait = serverLockWait - o.serverLockWait;
+	r.rpcWait = rpcWait - o.rpcWait;
+	r.filesTransferred = filesTransferred - o.filesTransferred;
+	r.bytesTransferred = bytesTransferred - o.bytesTransferred;
+	r.transferTime = transferTime - o.transferTime;
+	return r;
+}
+
+static std::string FormatMilliseconds(Microseconds t)
+{
+	std::stringstream ss;
+	ss << t / 1000 << '.' << std::setw(3) << std::setfill('0') << t % 1000 << " ms";
+	return ss.str();
+}
+
+Metrics::Metrics()
+	: m_InUnityCommand(false), m_UnityStart(0), m_UnityTime(0), m_QueueWait(0)
+{
+}
+
+void Metrics::BeginUnityCommand(const std::string& name)
+{
+	m_InUnityCommand = true;
+	m_UnityCommand = name;
+	m_Current = CommandCounters();
+	m_ServerTimes.clear();
+	m_QueueWait = 0;
+	m_UnityStart = GetMonotonicTime();
+}
+
+bool Metrics::EndUnityCommand()
+{
+	if (!m_InUnityCommand)
+		return false;
+
+	m_InUnityCommand = false;
+	m_UnityTime = GetMonotonicTime() - m_UnityStart;
+
+	CommandStats& stats = m_UnityCommands[m_UnityCommand];
+	stats.latency.Add(m_UnityTime);
+	stats.counters += m_Current;
+	return true;
+}
+
+Metrics::Mark Metrics::BeginServerCommand()
+{
+	++m_Current.roundTrips;
+	Mark mark;
+	mark.counters = m_Current;
+	mark.start = GetMonotonicTime();
+	return mark;
+}
+
+void Metrics::EndServerCommand(const std::string& name, const Mark& mark)
+{
+	Microseconds t = GetMonotonicTime() - mark.start;
+
+	CommandStats& stats = m_ServerCommands[name];
+	stats.latency.Add(t);
+	CommandCounters delta = m_Current - mark.counters;
+	++delta.roundTrips;
+	stats.counters += delta;
+
+	m_ServerTimes.push_back(std::make_pair(name, t));
+}
+
+void Metrics::AddRecord(size_t bytes)
+{
+	++m_Current.records;
+	m_Current.bytesReceived += bytes;
+}
+
+void Metrics::AddBytesWritten(size_t bytes)
+{
+	m_Current.bytesWritten += bytes;
+}
+
+void Metrics::AddReconnect()
+{
+	++m_Current.reconnects;
+}
+
+void Metrics::AddHandshakeTime(Microseconds t)
+{
+	m_Current.handshakeTime += t;
+}
+
+void Metrics::AddRelogin()
+{
+	++m_Current.relogins;
+}
+
+void Metrics::AddLoginTime(Microseconds t)
+{
+	m_Current.loginTime += t;
+}
+
+void Metrics::AddServerTrack(Microseconds lapse, Microseconds lockWait, Microseconds rpcWait)
+{
+	++m_Current.trackedCommands;
+	m_Current.serverLapse += lapse;
+	m_Current.serverLockWait += lockWait;
+	m_Current.rpcWait += rpcWait;
+}
+
+void Metrics::AddTransfer(unsigned int files, unsigned long long bytes, Microseconds t)
+{
+	m_Current.filesTransferred += files;
+	m_Current.bytesTransferred += bytes;
+	m_Current.transferTime += t;
+}
+
+void Metrics::AddQueueWait(const std::string& priorityClass, Microseconds t)
+{
+	m_QueueWaits[priorityClass].Add(t);
+	m_QueueWait += t;
+}
+
+void Metrics::Add(const Metrics& other)
+{
+	AddStats(m_UnityCommands, other.m_UnityCommands);
+	AddStats(m_ServerCommands, other.m_ServerCommands);
+	for (std::map<std::string, LatencyHistogram>::const_iterator i = other.m_QueueWaits.begin(); i != other.m_QueueWaits.end(); ++i)
+		m_QueueWaits[i->first].Add(i->second);
+
+	// Work not done as a Unity command of its own counts for the current one
+	if (other.m_UnityCommand.empty())
+	{
+		m_Current += other.m_Current;
+		m_ServerTimes.insert(m_ServerTimes.end(), other.m_ServerTimes.begin(), other.m_ServerTimes.end());
+	}
+}
+
+void Metrics::AddStats(StatsMap& stats, const StatsMap& other)
+{
+	for (StatsMap::const_iterator i = other.begin(); i != other.end(); ++i)
+	{
+		CommandStats& s = stats[i->first];
+		s.latency.Add(i->second.latency);
+		s.counters += i->second.counters;
+	}
+}
+
+std::string Metrics::GetSummary() const
+{
+	const size_t kMaxServerTimes = 16;
+
+	std::stringstream ss;
+	ss << m_UnityCommand << " took " << FormatMilliseconds(m_UnityTime) << ": "
+	   << m_Current.roundTrips << " round trips, "
+	   << m_Current.records << " records, "
+	   << m_Current.bytesReceived << " bytes received, "
+	   << m_Current.bytesWritten << " bytes written";
+
+	if (m_QueueWait)
+		ss << ", queued " << FormatMilliseconds(m_QueueWait);
+
+	if (m_Current.loginTime || m_Current.reconnects || m_Current.relogins)
+		ss << ", login " << FormatMilliseconds(m_Current.loginTime) << " with " << m_Current.reconnects << " reconnects ("
+		   << FormatMilliseconds(m_Current.handshakeTime) << " handshake) and " << m_Current.relogins << " relogins";
+
+	if (m_Current.trackedCommands)
+		ss << ", server lapse " << FormatMilliseconds(m_Current.serverLapse)
+		   << ", db lock wait " << FormatMilliseconds(m_Current.serverLockWait)
+		   << ", rpc wait " << FormatMilliseconds(m_Current.rpcWait);
+
+	if (m_Current.filesTransferred)
+	{
+		ss << ", transferred " << m_Current.filesTransferred << " files (" << m_Current.bytesTransferred << " bytes) in "
+		   << FormatMilliseconds(m_Current.transferTime);
+		if (m_Current.transferTime)
+			ss << " at " << m_Current.bytesTransferred * 1000000 / m_Current.transferTime / 1024 << " KB/s";
+	}
+
+	if (!m_ServerTimes.empty())
+	{
+		ss << " [";
+		for (size_t i = 0; i < m_ServerTimes.size() && i < kMaxServerTimes; ++i)
+			ss << (i ? ", " : "") << m_ServerTimes[i].first << " " << FormatMilliseconds(m_ServerTimes[i].second);
+		if (m_ServerTimes.size() > kMaxServerTimes)
+			ss << ", ...";
+		ss << "]";
+	}
+	return ss.str();
+}
+
+static void WriteJSONString(std::ostream& os, const std::string& s)
+{
+	os << '"';
+	for (std::string::const_iterator i = s.begin(); i != s.end(); ++i)
+	{
+		if (*i == '"' || *i == '\\')
+			os << '\\' << *i;
+		else if ((unsigned char)*i < 0x20)
+			os << ' ';
+		else
+			os << *i;
+	}
+	os << '"';
+}
+
+void Metrics::WriteStats(std::ostream& os, const StatsMap& stats)
+{
+	os << "{";
+	for (StatsMap::const_iterator i = stats.begin(); i != stats.end(); ++i)
+	{
+		const LatencyHistogram& h = i->second.latency;
+		const CommandCounters& c = i->second.counters;
+
+		os << (i == stats.begin() ? "\n\t\t" : ",\n\t\t");
+		WriteJSONString(os, i->first);
+		os << ": {\"count\": " << h.GetCount()
+		   << ", \"totalUs\": " << h.GetTotal()
+		   << ", \"minUs\": " << h.GetMin()
+		   << ", \"maxUs\": " << h.GetMax()
+		   << ", \"p50Us\": " << h.GetPercentile(50)
+		   << ", \"p90Us\": " << h.GetPercentile(90)
+		   << ", \"p99Us\": " << h.GetPercentile(99)
+		   << ", \"roundTrips\": " << c.roundTrips
+		   << ", \"records\": " << c.records
+		   << ", \"bytesReceived\": " << c.bytesReceived
+		   << ", \"bytesWritten\": " << c.bytesWritten
+		   << ", \"reconnects\": " << c.reconnects
+		   << ", \"handshakeUs\": " << c.handshakeTime
+		   << ", \"relogins\": " << c.relogins
+		   << ", \"loginUs\": " << c.loginTime
+		   << ", \"trackedCommands\": " << c.trackedCommands
+		   << ", \"serverLapseUs\": " << c.serverLapse
+		   << ", \"serverLockWaitUs\": " << c.serverLockWait
+		   << ", \"rpcWaitUs\": " << c.rpcWait
+		   << ", \"filesTransferred\": " << c.filesTransferred
+		   << ", \"bytesTransferred\": " << c.bytesTransferred
+		   << ", \"transferUs\": " << c.transferTime
+		   << ", \"histogram\": [";
+
+		// Only non empty buckets as [upper bound in us, count] pairs
+		bool first = true;
+		for (int b = 0; b < LatencyHistogram::kBucketCount; ++b)
+		{
+			if (!h.GetBucket(b))
+				continue;
+			os << (first ? "" : ", ") << "[" << LatencyHistogram::GetBucketUpperBound(b) << ", " << h.GetBucket(b) << "]";
+			first = false;
+		}
+		os << "]}";
+	}
+	os << "\n\t}";
+}
+
+void Metrics::Write(std::ostream& os) const
+{
+	os << "{\n\t\"unityCommands\": ";
+	WriteStats(os, m_UnityCommands);
+	os << ",\n\t\"serverCommands\": ";
+	WriteStats(os, m_ServerCommands);
+	os << ",\n\t\"queueWait\": {";
+	for (std::map<std::string, LatencyHistogram>::const_iterator i = m_QueueWaits.begin(); i != m_QueueWaits.end(); ++i)
+	{
+		const LatencyHistogram& h = i->second;
+		os << (i == m_QueueWaits.begin() ? "\n\t\t" : ",\n\t\t");
+		WriteJSONString(os, i->first);
+		os << ": {\"count\": " << h.GetCount()
+		   << ", \"totalUs\": " << h.GetTotal()
+		   << ", \"maxUs\": " << h.GetMax()
+		   << ", \"p50Us\": " << h.GetPercentile(50)
+		   << ", \"p90Us\": " << h.GetPercentile(90)
+		   << ", \"p99Us\": " << h.GetPercentile(99) << "}";
+	}
+	os << "\n\t}\n}\n";
+}
+
+bool Metrics::WriteFile(const std::string& path) const
+{
+	std::ofstream os(path.c_str(), std::ios_base::out | std::ios_base::trunc);
+	if (!os)
+		return false;
+	Write(os);
+	os.close();
+	return !os.fail();
+}
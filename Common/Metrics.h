@@ -0,0 +1,139 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <ostream>
+
+// Microseconds read from a monotonic clock. Only differences are meaningful.
+typedef unsigned long long Microseconds;
+Microseconds GetMonotonicTime();
+
+// Latency histogram with power of two buckets. Bucket i counts the samples in
+// [2^i, 2^(i+1)) microseconds which covers anything up to about an hour.
+class LatencyHistogram
+{
+public:
+	enum { kBucketCount = 32 };
+
+	LatencyHistogram();
+
+	void Add(Microseconds t);
+	void Add(const LatencyHistogram& other);
+
+	unsigned int GetCount() const { return m_Count; }
+	Microseconds GetTotal() const { return m_Total; }
+	Microseconds GetMin() const { return m_Count ? m_Min : 0; }
+	Microseconds GetMax() const { return m_Max; }
+
+	// Upper bound of the bucket that holds the given percentile (0-100),
+	// clamped to the largest sample seen.
+	Microseconds GetPercentile(int pct) const;
+
+	unsigned int GetBucket(int i) const { return m_Buckets[i]; }
+	static Microseconds GetBucketUpperBound(int i);
+
+private:
+	unsigned int m_Buckets[kBucketCount];
+	unsigned int m_Count;
+	Microseconds m_Total;
+	Microseconds m_Min;
+	Microseconds m_Max;
+};
+
+// Counters collected while running a command
+struct CommandCounters
+{
+	CommandCounters();
+	CommandCounters& operator+=(const CommandCounters& o);
+	CommandCounters operator-(const CommandCounters& o) const;
+
+	unsigned int roundTrips;          // commands sent to the server
+	unsigned int records;             // tagged records, messages and text chunks received
+	unsigned long long bytesReceived; // payload of the above
+	unsigned long long bytesWritten;  // written to the Unity pipe
+	unsigned int reconnects;          // new connections, for ssl each with a full handshake
+	Microseconds handshakeTime;       // spent setting up the new connections
+	unsigned int relogins;            // logins done again on an existing connection
+	Microseconds loginTime;           // spent on login checks, reconnects and logins
+	unsigned int trackedCommands;     // commands with server side tracking figures below
+	Microseconds serverLapse;
+	Microseconds serverLockWait;
+	Microseconds rpcWait;
+	unsigned int filesTransferred;    // files synced or submitted
+	unsigned long long bytesTransferred;
+	Microseconds transferTime;        // spent in the commands transferring them
+};
+
+struct CommandStats
+{
+	LatencyHistogram latency;
+	CommandCounters counters;
+};
+
+// Timing and traffic metrics for the Unity commands handled by the plugin and
+// for the version control commands run on their behalf.
+class Metrics
+{
+public:
+	// Snapshot taken when a server command starts
+	struct Mark
+	{
+		Microseconds start;
+		CommandCounters counters;
+	};
+
+	Metrics();
+
+	void BeginUnityCommand(const std::string& name);
+
+	// Returns false if no Unity command was in progress
+	bool EndUnityCommand();
+
+	Mark BeginServerCommand();
+	void EndServerCommand(const std::string& name, const Mark& mark);
+
+	void AddRecord(size_t bytes);
+	void AddBytesWritten(size_t bytes);
+	void AddReconnect();
+	void AddHandshakeTime(Microseconds t);
+	void AddRelogin();
+	void AddLoginTime(Microseconds t);
+
+	// Time the current Unity command waited before it could start, by priority
+	// class. See UnityCommandToPriority().
+	void AddQueueWait(const std::string& priorityClass, Microseconds t);
+
+	// Files moved between the workspace and the server by a sync or submit
+	void AddTransfer(unsigned int files, unsigned long long bytes, Microseconds t);
+
+	// Server side performance tracking figures of a command
+	void AddServerTrack(Microseconds lapse, Microseconds lockWait, Microseconds rpcWait);
+
+	// Add what another instance has collected e.g. on a background thread.
+	// If no Unity command was begun on it its counters go to the current one.
+	void Add(const Metrics& other);
+
+	// One line summary of the last Unity command ended
+	std::string GetSummary() const;
+
+	// Write all collected metrics as JSON
+	void Write(std::ostream& os) const;
+	bool WriteFile(const std::string& path) const;
+
+private:
+	typedef std::map<std::string, CommandStats> StatsMap;
+	static void WriteStats(std::ostream& os, const StatsMap& stats);
+	static void AddStats(StatsMap& stats, const StatsMap& other);
+
+	StatsMap m_UnityCommands;
+	StatsMap m_ServerCommands;
+	std::map<std::string, LatencyHistogram> m_QueueWaits;
+
+	bool m_InUnityCommand;
+	std::string m_UnityCommand;
+	Microseconds m_UnityStart;
+	Microseconds m_UnityTime;
+	Microseconds m_QueueWait;
+	CommandCounters m_Current;
+	std::vector<std::pair<std::string, Microseconds> > m_ServerTimes;
+};
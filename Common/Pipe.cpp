@@ -1,7 +1,12 @@
 #include "Pipe.h"
 #include "Utility.h"
+#include <string.h>
+#if !defined(_WINDOWS)
+#include <poll.h>
+#include <unistd.h>
+#endif
 
-Pipe::Pipe() : m_LineBufferValid(false)
+Pipe::Pipe() : m_LineBufferValid(false), m_BytesWritten(0)
 {
 #if defined(_WINDOWS)
 	LPTSTR lpszPipename = TEXT("\\\\.\\pipe\\UnityVCS"); 
@@ -78,7 +83,19 @@ Pipe& Pipe::Write(const std::string& str)
 #else
 	std::cout << str;
 #endif
+	m_BytesWritten += str.length();
+	return *this;
+}
+
+Pipe& Pipe::Write(const char* str)
+{
+#if defined(_WINDOWS)
+	return Write(std::string(str));
+#else
+	std::cout << str;
+	m_BytesWritten += strlen(str);
 	return *this;
+#endif
 }
 
 
@@ -157,3 +174,25 @@ bool Pipe::IsEOF() const
 	return std::cin.eof();
 #endif
 }
+
+bool Pipe::HasInput() const
+{
+	if (m_LineBufferValid)
+		return true;
+#if defined(_WINDOWS)
+	if (!m_Buffer.empty())
+		return true;
+	DWORD available = 0;
+	if (!PeekNamedPipe(m_NamedPipe, NULL, 0, NULL, &available, NULL))
+		return true; // a read will report what is wrong
+	return available > 0;
+#else
+	if (std::cin.rdbuf()->in_avail() > 0)
+		return true;
+	struct pollfd fd;
+	fd.fd = STDIN_FILENO;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	return poll(&fd, 1, 0) != 0;
+#endif
+}
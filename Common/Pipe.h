@@ -33,25 +33,25 @@ public:
 	template <typename T>
 	Pipe& Write(const T& v)
 	{
-#if defined(_WINDOWS)
-		std::stringstream ss;
-		ss << v;
-		std::string str = ss.str();
-		Write(ss.str());
-#else
-		std::cout << v;
-#endif
-		return *this;
+		return Write(ToString(v));
 	}
 
 	Pipe& Write(const std::string& str);
+	Pipe& Write(const char* str);
 	std::string& ReadLine(std::string& target);
 	std::string& PeekLine(std::string& dest);
 	bool IsEOF() const;
 
+	// True if a line or part of one can be read without waiting
+	bool HasInput() const;
+
+	// Total number of bytes written to the pipe
+	unsigned long long GetBytesWritten() const { return m_BytesWritten; }
+
 private:
 	bool m_LineBufferValid;
 	std::string m_LineBuffer;
+	unsigned long long m_BytesWritten;
 
 #if defined(_WINDOWS)
 	HANDLE m_NamedPipe;
@@ -0,0 +1,69 @@
+#include "ProgressReporter.h"
+#include "Connection.h"
+
+ProgressReporter::ProgressReporter(Connection& conn)
+	: m_Conn(conn), m_StartTime(0), m_TotalFiles(0), m_TotalBytes(0), m_Files(0), m_Bytes(0),
+	  m_LastSent(0), m_HasPending(false)
+{
+}
+
+void ProgressReporter::Begin(unsigned int totalFiles, unsigned long long totalBytes)
+{
+	m_StartTime = time(0);
+	m_TotalFiles = totalFiles;
+	m_TotalBytes = totalBytes;
+	m_Files = 0;
+	m_Bytes = 0;
+	m_LastSent = 0;
+	m_HasPending = false;
+	m_Pending.clear();
+}
+
+void ProgressReporter::Step(unsigned long long bytes, const std::string& message)
+{
+	++m_Files;
+	m_Bytes += bytes;
+	Send(message, false);
+}
+
+void ProgressReporter::Update(const std::string& message)
+{
+	Send(message, false);
+}
+
+void ProgressReporter::Finish()
+{
+	if (m_HasPending)
+		Send(m_Pending, true);
+}
+
+int ProgressReporter::GetPercentage() const
+{
+	unsigned long long pct;
+	if (m_TotalBytes)
+		pct = m_Bytes * 100 / m_TotalBytes;
+	else if (m_TotalFiles)
+		pct = (unsigned long long)m_Files * 100 / m_TotalFiles;
+	else
+		return -1;
+
+	// The totals are estimates
+	return pct > 100 ? 100 : (int)pct;
+}
+
+void ProgressReporter::Send(const std::string& message, bool force)
+{
+	Microseconds now = GetMonotonicTime();
+	Microseconds interval = m_Conn.GetProgressInterval();
+	if (!force && interval && m_LastSent && now - m_LastSent < interval)
+	{
+		m_HasPending = true;
+		m_Pending = message;
+		return;
+	}
+
+	m_Conn.Progress(GetPercentage(), time(0) - m_StartTime, message);
+	m_LastSent = now;
+	m_HasPending = false;
+	m_Pending.clear();
+}
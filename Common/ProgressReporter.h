@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <time.h>
+#include "Metrics.h"
+
+class Connection;
+
+// Progress of a command transferring files, sent to Unity as a percentage of
+// the bytes when their total is known and of the files otherwise. Updates
+// closer together than the progress interval of the connection are held back
+// and the last one is sent by Finish().
+class ProgressReporter
+{
+public:
+	ProgressReporter(Connection& conn);
+
+	// Totals of 0 are unknown. With both unknown no percentage is sent.
+	void Begin(unsigned int totalFiles, unsigned long long totalBytes);
+
+	// A file of the given size is done
+	void Step(unsigned long long bytes, const std::string& message);
+
+	// Message that does not tell of any progress e.g. locking files
+	void Update(const std::string& message);
+
+	void Finish();
+
+private:
+	int GetPercentage() const;
+	void Send(const std::string& message, bool force);
+
+	Connection& m_Conn;
+	time_t m_StartTime;
+	unsigned int m_TotalFiles;
+	unsigned long long m_TotalBytes;
+	unsigned int m_Files;
+	unsigned long long m_Bytes;
+	Microseconds m_LastSent;
+	bool m_HasPending;
+	std::string m_Pending;
+};
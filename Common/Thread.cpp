@@ -0,0 +1,312 @@
+#include "Thread.h"
+
+#if defined(_WINDOWS)
+
+long AtomicIncrement(volatile long* v)
+{
+	return InterlockedIncrement(v);
+}
+
+long AtomicDecrement(volatile long* v)
+{
+	return InterlockedDecrement(v);
+}
+
+long AtomicAdd(volatile long* v, long delta)
+{
+	return InterlockedExchangeAdd(v, delta) + delta;
+}
+
+long AtomicCompareExchange(volatile long* v, long exchange, long comparand)
+{
+	return InterlockedCompareExchange(v, exchange, comparand);
+}
+
+long AtomicLoad(volatile long* v)
+{
+	return InterlockedCompareExchange(v, 0, 0);
+}
+
+void AtomicStore(volatile long* v, long value)
+{
+	InterlockedExchange(v, value);
+}
+
+void SleepMilliseconds(int ms)
+{
+	Sleep(ms);
+}
+
+Mutex::Mutex()
+{
+	InitializeCriticalSection(&m_Section);
+}
+
+Mutex::~Mutex()
+{
+	DeleteCriticalSection(&m_Section);
+}
+
+void Mutex::Lock()
+{
+	EnterCriticalSection(&m_Section);
+}
+
+void Mutex::Unlock()
+{
+	LeaveCriticalSection(&m_Section);
+}
+
+Event::Event()
+{
+	m_Event = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+Event::~Event()
+{
+	CloseHandle(m_Event);
+}
+
+void Event::Set()
+{
+	SetEvent(m_Event);
+}
+
+bool Event::Wait(int timeoutMs)
+{
+	return WaitForSingleObject(m_Event, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs) == WAIT_OBJECT_0;
+}
+
+static DWORD s_MainThreadId = GetCurrentThreadId();
+
+bool Thread::IsMainThread()
+{
+	return GetCurrentThreadId() == s_MainThreadId;
+}
+
+Thread::Thread() : m_Handle(NULL), m_Function(NULL), m_UserData(NULL), m_Started(false)
+{
+}
+
+bool Thread::Start(Function func, void* userData)
+{
+	m_Function = func;
+	m_UserData = userData;
+	m_Handle = CreateThread(NULL, 0, &Thread::Run, this, 0, NULL);
+	m_Started = m_Handle != NULL;
+	return m_Started;
+}
+
+void Thread::Join()
+{
+	if (!m_Started)
+		return;
+	WaitForSingleObject(m_Handle, INFINITE);
+	CloseHandle(m_Handle);
+	m_Handle = NULL;
+	m_Started = false;
+}
+
+DWORD WINAPI Thread::Run(LPVOID param)
+{
+	Thread* t = static_cast<Thread*>(param);
+	t->m_Function(t->m_UserData);
+	return 0;
+}
+
+ThreadLocalPointer::ThreadLocalPointer()
+{
+	m_Index = TlsAlloc();
+}
+
+ThreadLocalPointer::~ThreadLocalPointer()
+{
+	TlsFree(m_Index);
+}
+
+void* ThreadLocalPointer::Get() const
+{
+	return TlsGetValue(m_Index);
+}
+
+void ThreadLocalPointer::Set(void* value)
+{
+	TlsSetValue(m_Index, value);
+}
+
+#else // pthreads
+
+#include <errno.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+long AtomicIncrement(volatile long* v)
+{
+	return __sync_add_and_fetch(v, 1);
+}
+
+long AtomicDecrement(volatile long* v)
+{
+	return __sync_sub_and_fetch(v, 1);
+}
+
+long AtomicAdd(volatile long* v, long delta)
+{
+	return __sync_add_and_fetch(v, delta);
+}
+
+long AtomicCompareExchange(volatile long* v, long exchange, long comparand)
+{
+	return __sync_val_compare_and_swap(v, comparand, exchange);
+}
+
+long AtomicLoad(volatile long* v)
+{
+	__sync_synchronize();
+	long value = *v;
+	__sync_synchronize();
+	return value;
+}
+
+void AtomicStore(volatile long* v, long value)
+{
+	__sync_synchronize();
+	*v = value;
+	__sync_synchronize();
+}
+
+void SleepMilliseconds(int ms)
+{
+	usleep(ms * 1000);
+}
+
+Mutex::Mutex()
+{
+	pthread_mutex_init(&m_Mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+	pthread_mutex_destroy(&m_Mutex);
+}
+
+void Mutex::Lock()
+{
+	pthread_mutex_lock(&m_Mutex);
+}
+
+void Mutex::Unlock()
+{
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+Event::Event() : m_Signaled(false)
+{
+	pthread_mutex_init(&m_Mutex, NULL);
+	pthread_cond_init(&m_Cond, NULL);
+}
+
+Event::~Event()
+{
+	pthread_cond_destroy(&m_Cond);
+	pthread_mutex_destroy(&m_Mutex);
+}
+
+void Event::Set()
+{
+	pthread_mutex_lock(&m_Mutex);
+	m_Signaled = true;
+	pthread_cond_signal(&m_Cond);
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+bool Event::Wait(int timeoutMs)
+{
+	pthread_mutex_lock(&m_Mutex);
+	if (timeoutMs < 0)
+	{
+		while (!m_Signaled)
+			pthread_cond_wait(&m_Cond, &m_Mutex);
+	}
+	else if (!m_Signaled)
+	{
+		// pthread_cond_timedwait wants an absolute realtime deadline
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		struct timespec deadline;
+		long long nsec = (long long)now.tv_usec * 1000 + (long long)(timeoutMs % 1000) * 1000000;
+		deadline.tv_sec = now.tv_sec + timeoutMs / 1000 + (time_t)(nsec / 1000000000);
+		deadline.tv_nsec = (long)(nsec % 1000000000);
+		while (!m_Signaled)
+		{
+			if (pthread_cond_timedwait(&m_Cond, &m_Mutex, &deadline) == ETIMEDOUT)
+				break;
+		}
+	}
+	bool signaled = m_Signaled;
+	m_Signaled = false;
+	pthread_mutex_unlock(&m_Mutex);
+	return signaled;
+}
+
+static pthread_t s_MainThread = pthread_self();
+
+bool Thread::IsMainThread()
+{
+	return pthread_equal(pthread_self(), s_MainThread) != 0;
+}
+
+Thread::Thread() : m_Function(NULL), m_UserData(NULL), m_Started(false)
+{
+}
+
+bool Thread::Start(Function func, void* userData)
+{
+	m_Function = func;
+	m_UserData = userData;
+	m_Started = pthread_create(&m_Handle, NULL, &Thread::Run, this) == 0;
+	return m_Started;
+}
+
+void Thread::Join()
+{
+	if (!m_Started)
+		return;
+	pthread_join(m_Handle, NULL);
+	m_Started = false;
+}
+
+void* Thread::Run(void* param)
+{
+	Thread* t = static_cast<Thread*>(param);
+	t->m_Function(t->m_UserData);
+	return NULL;
+}
+
+ThreadLocalPointer::ThreadLocalPointer()
+{
+	pthread_key_create(&m_Key, NULL);
+}
+
+ThreadLocalPointer::~ThreadLocalPointer()
+{
+	pthread_key_delete(m_Key);
+}
+
+void* ThreadLocalPointer::Get() const
+{
+	return pthread_getspecific(m_Key);
+}
+
+void ThreadLocalPointer::Set(void* value)
+{
+	pthread_setspecific(m_Key, value);
+}
+
+#endif
+
+Thread::~Thread()
+{
+	Join();
+}
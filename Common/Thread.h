@@ -0,0 +1,124 @@
+#pragma once
+
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Atomic operations. All of them act as full memory barriers.
+long AtomicIncrement(volatile long* v);  // returns the new value
+long AtomicDecrement(volatile long* v);  // returns the new value
+long AtomicAdd(volatile long* v, long delta); // returns the new value
+long AtomicCompareExchange(volatile long* v, long exchange, long comparand); // returns the old value
+long AtomicLoad(volatile long* v);
+void AtomicStore(volatile long* v, long value);
+
+void SleepMilliseconds(int ms);
+
+class Mutex
+{
+public:
+	Mutex();
+	~Mutex();
+	void Lock();
+	void Unlock();
+
+private:
+	Mutex(const Mutex&);
+	Mutex& operator=(const Mutex&);
+
+#if defined(_WINDOWS)
+	CRITICAL_SECTION m_Section;
+#else
+	pthread_mutex_t m_Mutex;
+#endif
+};
+
+class MutexLock
+{
+public:
+	MutexLock(Mutex& m) : m_Mutex(m) { m_Mutex.Lock(); }
+	~MutexLock() { m_Mutex.Unlock(); }
+
+private:
+	MutexLock(const MutexLock&);
+	MutexLock& operator=(const MutexLock&);
+
+	Mutex& m_Mutex;
+};
+
+// Auto reset event. A Set() wakes up one waiter or the next one to wait.
+class Event
+{
+public:
+	Event();
+	~Event();
+	void Set();
+
+	// Returns false on timeout. A negative timeout waits forever.
+	bool Wait(int timeoutMs = -1);
+
+private:
+	Event(const Event&);
+	Event& operator=(const Event&);
+
+#if defined(_WINDOWS)
+	HANDLE m_Event;
+#else
+	pthread_mutex_t m_Mutex;
+	pthread_cond_t m_Cond;
+	bool m_Signaled;
+#endif
+};
+
+class Thread
+{
+public:
+	typedef void (*Function)(void* userData);
+
+	Thread();
+	~Thread();
+
+	bool Start(Function func, void* userData);
+	void Join();
+	bool IsStarted() const { return m_Started; }
+
+	// True when called on the thread that started the process
+	static bool IsMainThread();
+
+private:
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+
+#if defined(_WINDOWS)
+	static DWORD WINAPI Run(LPVOID param);
+	HANDLE m_Handle;
+#else
+	static void* Run(void* param);
+	pthread_t m_Handle;
+#endif
+	Function m_Function;
+	void* m_UserData;
+	bool m_Started;
+};
+
+// A pointer with a separate value per thread. Values are not freed on thread exit.
+class ThreadLocalPointer
+{
+public:
+	ThreadLocalPointer();
+	~ThreadLocalPointer();
+	void* Get() const;
+	void Set(void* value);
+
+private:
+	ThreadLocalPointer(const ThreadLocalPointer&);
+	ThreadLocalPointer& operator=(const ThreadLocalPointer&);
+
+#if defined(_WINDOWS)
+	DWORD m_Index;
+#else
+	pthread_key_t m_Key;
+#endif
+};
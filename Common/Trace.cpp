@@ -0,0 +1,174 @@
+#include "Trace.h"
+#include <string.h>
+
+// Write the buffer to disk when it grows beyond this
+const size_t TRACE_BUFFER_SIZE = 64 * 1024;
+
+Tracer::Tracer() : m_Epoch(0)
+{
+}
+
+Tracer::~Tracer()
+{
+	Close();
+}
+
+bool Tracer::Open(const std::string& path)
+{
+	Close();
+
+	m_File.open(path.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	if (!m_File.is_open())
+		return false;
+
+	m_Epoch = GetMonotonicTime();
+	m_Buffer.reserve(TRACE_BUFFER_SIZE * 2);
+	m_Buffer = "[\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"PerforcePlugin\"}}";
+	return true;
+}
+
+void Tracer::Close()
+{
+	if (!IsEnabled())
+		return;
+
+	// Close any spans left open so that they show up in the trace
+	while (!m_Open.empty())
+		End();
+
+	m_Buffer += "\n]\n";
+	Flush();
+	m_File.close();
+	m_Buffer.clear();
+}
+
+void Tracer::Begin(const char* name, const char* category)
+{
+	m_Open.push_back(Span());
+	Span& span = m_Open.back();
+	span.name = name;
+	span.category = category;
+	span.start = GetMonotonicTime();
+}
+
+void Tracer::Begin(const std::string& name, const char* category)
+{
+	Begin(name.c_str(), category);
+}
+
+void Tracer::End()
+{
+	if (m_Open.empty())
+		return;
+
+	WriteEvent(m_Open.back(), GetMonotonicTime());
+	m_Open.pop_back();
+
+	if (m_Buffer.length() >= TRACE_BUFFER_SIZE)
+		Flush();
+}
+
+void Tracer::AddArg(const char* key, const std::string& value)
+{
+	if (!m_Open.empty())
+		AppendArg(m_Open.back().args, key, value);
+}
+
+void Tracer::AddArg(const char* key, unsigned long long value)
+{
+	if (!m_Open.empty())
+		AppendArg(m_Open.back().args, key, value);
+}
+
+void Tracer::AddRootArg(const char* key, const std::string& value)
+{
+	if (!m_Open.empty())
+		AppendArg(m_Open.front().args, key, value);
+}
+
+void Tracer::AddRootArg(const char* key, unsigned long long value)
+{
+	if (!m_Open.empty())
+		AppendArg(m_Open.front().args, key, value);
+}
+
+void Tracer::Flush()
+{
+	if (!IsEnabled() || m_Buffer.empty())
+		return;
+	m_File.write(m_Buffer.data(), m_Buffer.length());
+	m_File.flush();
+	m_Buffer.clear();
+}
+
+static void AppendJSONString(std::string& out, const char* s, size_t len)
+{
+	out += '"';
+	for (size_t i = 0; i < len; ++i)
+	{
+		char c = s[i];
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			out += ' ';
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	out += '"';
+}
+
+static void AppendNumber(std::string& out, unsigned long long v)
+{
+	char buf[24];
+	char* p = buf + sizeof(buf);
+	do
+	{
+		*--p = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+void Tracer::AppendArg(std::string& args, const char* key, const std::string& value)
+{
+	if (!args.empty())
+		args += ", ";
+	AppendJSONString(args, key, strlen(key));
+	args += ": ";
+	AppendJSONString(args, value.data(), value.length());
+}
+
+void Tracer::AppendArg(std::string& args, const char* key, unsigned long long value)
+{
+	if (!args.empty())
+		args += ", ";
+	AppendJSONString(args, key, strlen(key));
+	args += ": ";
+	AppendNumber(args, value);
+}
+
+void Tracer::WriteEvent(const Span& span, Microseconds end)
+{
+	m_Buffer += ",\n{\"name\": ";
+	AppendJSONString(m_Buffer, span.name.data(), span.name.length());
+	m_Buffer += ", \"cat\": \"";
+	m_Buffer += span.category;
+	m_Buffer += "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": ";
+	AppendNumber(m_Buffer, span.start - m_Epoch);
+	m_Buffer += ", \"dur\": ";
+	AppendNumber(m_Buffer, end - span.start);
+	if (!span.args.empty())
+	{
+		m_Buffer += ", \"args\": {";
+		m_Buffer += span.args;
+		m_Buffer += "}";
+	}
+	m_Buffer += "}";
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include "Metrics.h"
+
+// Writes spans in the Chrome trace event format that chrome://tracing and
+// ui.perfetto.dev can load. Events are kept in memory and written in large
+// chunks so that tracing is cheap enough to leave enabled.
+class Tracer
+{
+public:
+	Tracer();
+	~Tracer();
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsEnabled() const { return m_File.is_open(); }
+
+	// Spans must be properly nested. Use TraceScope instead of calling these directly.
+	void Begin(const char* name, const char* category);
+	void Begin(const std::string& name, const char* category);
+	void End();
+
+	// Attach an argument to the innermost open span
+	void AddArg(const char* key, const std::string& value);
+	void AddArg(const char* key, unsigned long long value);
+
+	// Attach an argument to the outermost open span e.g. the Unity command
+	void AddRootArg(const char* key, const std::string& value);
+	void AddRootArg(const char* key, unsigned long long value);
+
+	void Flush();
+
+private:
+	struct Span
+	{
+		std::string name;
+		const char* category;
+		Microseconds start;
+		std::string args;
+	};
+
+	static void AppendArg(std::string& args, const char* key, const std::string& value);
+	static void AppendArg(std::string& args, const char* key, unsigned long long value);
+	void WriteEvent(const Span& span, Microseconds end);
+
+	std::ofstream m_File;
+	std::string m_Buffer;
+	std::vector<Span> m_Open;
+	Microseconds m_Epoch;
+};
+
+// Traces the lifetime of the scope as a span when tracing is enabled
+class TraceScope
+{
+public:
+	TraceScope(Tracer& tracer, const char* name, const char* category = "plugin")
+		: m_Tracer(tracer.IsEnabled() ? &tracer : NULL)
+	{
+		if (m_Tracer)
+			m_Tracer->Begin(name, category);
+	}
+
+	TraceScope(Tracer& tracer, const std::string& name, const char* category = "plugin")
+		: m_Tracer(tracer.IsEnabled() ? &tracer : NULL)
+	{
+		if (m_Tracer)
+			m_Tracer->Begin(name, category);
+	}
+
+	~TraceScope()
+	{
+		if (m_Tracer)
+			m_Tracer->End();
+	}
+
+private:
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+
+	Tracer* m_Tracer;
+};
@@ -7,8 +7,8 @@ AR = ar
 GTK3_INCLUDE = -I/usr/include/gtk-3.0 -I/usr/include/glib-2.0 -I/usr/lib/x86_64-linux-gnu/glib-2.0/include -I/usr/include/pango-1.0 -I/usr/include/cairo -I/usr/include/gdk-pixbuf-2.0 -I/usr/include/atk-1.0 -I/usr/include/harfbuzz
 GTK3_LIBRARIES = -lgtk-3 -lgdk-3 -lpangocairo-1.0 -lpango-1.0 -latk-1.0 -lcairo-gobject -lcairo -lgdk_pixbuf-2.0 -lgio-2.0 -lgobject-2.0 -lglib-2.0
 
-CXXFLAGS += -O2 -g -fpermissive -Wno-deprecated-declarations $(GTK3_INCLUDE) $(P4PLUGIN_INCLUDE)
-LDFLAGS += -g
+CXXFLAGS += -O2 -g -pthread -fpermissive -Wno-deprecated-declarations $(GTK3_INCLUDE) $(P4PLUGIN_INCLUDE)
+LDFLAGS += -g -pthread
 LIBRARIES = -lstdc++ -lrt $(GTK3_LIBRARIES)
 
 COMMON_MODULES = $(COMMON_SRCS:.c=.o)
@@ -18,6 +18,22 @@ TESTSERVER_MODULES = $(TESTSERVER_SRCS:.c=.o)
 TESTSERVER_MODULES := $(TESTSERVER_SRCS:.cpp=.o)
 TESTSERVER_TARGET= Build/$(PLATFORM)/TestServer
 
+LOGBENCHMARK_MODULES = $(LOGBENCHMARK_SRCS:.cpp=.o)
+LOGBENCHMARK_TARGET = Build/$(PLATFORM)/LogBenchmark
+
+WILDCARDTEST_MODULES = $(WILDCARDTEST_SRCS:.cpp=.o)
+WILDCARDTEST_TARGET = Build/$(PLATFORM)/WildcardTest
+
+# The vector code paths are for Intel only
+ifneq ($(filter x86_64 i%86,$(shell uname -m)),)
+WILDCARDTEST_VARIANTS = scalar sse2 avx2
+else
+WILDCARDTEST_VARIANTS = scalar
+endif
+
+CONNECTIONUSETEST_MODULES = $(CONNECTIONUSETEST_SRCS:.cpp=.o)
+CONNECTIONUSETEST_TARGET = Build/$(PLATFORM)/ConnectionUseTest
+
 P4PLUGIN_MODULES = $(P4PLUGIN_SRCS:.c=.o)
 P4PLUGIN_MODULES := $(P4PLUGIN_MODULES:.cpp=.o)
 P4PLUGIN_TARGET = PerforcePlugin
@@ -30,6 +46,18 @@ all: P4Plugin testserver
 testserver: $(TESTSERVER_TARGET)
 	@mkdir -p Build/$(PLATFORM)
 
+# Not part of all. Run as: Build/$(PLATFORM)/LogBenchmark > /dev/null
+logbenchmark: $(LOGBENCHMARK_TARGET)
+
+# Not part of all. Checks the wildcard codec of P4Utility.cpp built with each
+# of its code paths and times it.
+wildcardtest: $(WILDCARDTEST_VARIANTS:%=$(WILDCARDTEST_TARGET)-%)
+	for v in $(WILDCARDTEST_VARIANTS); do $(WILDCARDTEST_TARGET)-$$v $$v || exit 1; done
+
+# Not part of all. Checks how the health monitor shares the connection.
+connectionusetest: $(CONNECTIONUSETEST_TARGET)
+	$(CONNECTIONUSETEST_TARGET)
+
 P4Plugin: $(P4PLUGIN_TARGET)
 	mkdir -p Build/$(PLATFORM)
 	cp $(P4PLUGIN_TARGET) Build/$(PLATFORM)
@@ -48,8 +76,29 @@ P4Plugin/Source/%.o : P4Plugin/Source/%.cpp $(COMMON_INCLS) $(P4PLUGIN_INCLS)
 $(TESTSERVER_TARGET): $(COMMON_MODULES) $(TESTSERVER_MODULES)
 	$(CXX) -g $(LDFLAGS) -o $@ $^
 
+$(LOGBENCHMARK_TARGET): $(COMMON_MODULES) $(LOGBENCHMARK_MODULES)
+	@mkdir -p Build/$(PLATFORM)
+	$(CXX) $(LDFLAGS) -o $@ $^
+
+Test/Source/P4Utility-scalar.o : P4Plugin/Source/P4Utility.cpp $(COMMON_INCLS) $(P4PLUGIN_INCLS)
+	$(CXX) $(CXXFLAGS) $(P4PLUGIN_INCLUDE) -D_LINUX -DP4_WILDCARD_SCALAR -c $< -o $@
+
+Test/Source/P4Utility-sse2.o : P4Plugin/Source/P4Utility.cpp $(COMMON_INCLS) $(P4PLUGIN_INCLS)
+	$(CXX) $(CXXFLAGS) $(P4PLUGIN_INCLUDE) -D_LINUX -msse2 -c $< -o $@
+
+Test/Source/P4Utility-avx2.o : P4Plugin/Source/P4Utility.cpp $(COMMON_INCLS) $(P4PLUGIN_INCLS)
+	$(CXX) $(CXXFLAGS) $(P4PLUGIN_INCLUDE) -D_LINUX -mavx2 -c $< -o $@
+
+$(WILDCARDTEST_TARGET)-% : $(COMMON_MODULES) $(WILDCARDTEST_MODULES) Test/Source/P4Utility-%.o
+	@mkdir -p Build/$(PLATFORM)
+	$(CXX) $(LDFLAGS) -o $@ $^
+
+$(CONNECTIONUSETEST_TARGET): $(COMMON_MODULES) $(CONNECTIONUSETEST_MODULES)
+	@mkdir -p Build/$(PLATFORM)
+	$(CXX) $(LDFLAGS) -o $@ $^
+
 $(P4PLUGIN_TARGET): $(COMMON_MODULES) $(P4PLUGIN_MODULES)
 	$(CXX) $(LDFLAGS) -o $@ $^  $(P4PLUGIN_LINK) -L./P4Plugin/Source/r19.1/lib/$(PLATFORM) 
 
 clean:
-	rm -f Build/*.* $(COMMON_MODULES) $(P4PLUGIN_MODULES) $(TESTSERVER_MODULES)
+	rm -f Build/*.* $(COMMON_MODULES) $(P4PLUGIN_MODULES) $(TESTSERVER_MODULES) $(LOGBENCHMARK_MODULES) $(WILDCARDTEST_MODULES) $(CONNECTIONUSETEST_MODULES) Test/Source/P4Utility-*.o
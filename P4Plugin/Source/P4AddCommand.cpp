@@ -70,7 +70,7 @@ public:
 	{
 		std::string paths = ResolvePaths(assetList, kPathWild | kPathSkipFolders);
 
-		Conn().Log().Debug() << "Paths to revert before add are: " << paths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths to revert before add are: " << paths << Endl;
 
 		if (paths.empty())
 			return;
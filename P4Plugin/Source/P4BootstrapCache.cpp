@@ -0,0 +1,104 @@
+#include "P4BootstrapCache.h"
+#include "FileSystem.h"
+#include "GZip.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static const char* kCacheHeader = "p4plugin bootstrap cache 1";
+
+P4BootstrapCache::P4BootstrapCache(const std::string& port, const std::string& user, const std::string& client)
+{
+	key = port + "\t" + user + "\t" + client;
+}
+
+bool P4BootstrapCache::IsValidFor(const std::string& update, const std::string& clientRoot) const
+{
+	return !specUpdate.empty() && specUpdate == update && root == clientRoot && !serverIdentity.empty();
+}
+
+std::string P4BootstrapCache::GetPath() const
+{
+	std::stringstream ss;
+	ss << "./Library/p4plugin-bootstrap-" << std::hex << std::setw(8) << std::setfill('0')
+	   << CRC32(0, (const unsigned char*)key.data(), key.length()) << ".txt";
+	return ss.str();
+}
+
+bool P4BootstrapCache::Load()
+{
+	std::ifstream in(GetPath().c_str());
+	if (!in.is_open())
+		return false;
+
+	std::string line;
+	if (!std::getline(in, line) || line != kCacheHeader)
+		return false;
+
+	P4BootstrapCache loaded(*this);
+	loaded.streams.clear();
+	bool keyMatches = false;
+	while (std::getline(in, line))
+	{
+		std::string::size_type i = line.find(' ');
+		if (i == std::string::npos)
+			continue;
+		std::string name = line.substr(0, i);
+		std::string value = line.substr(i + 1);
+
+		if (name == "key")
+			keyMatches = value == key;
+		else if (name == "server")
+			loaded.serverIdentity = value;
+		else if (name == "update")
+			loaded.specUpdate = value;
+		else if (name == "root")
+			loaded.root = value;
+		else if (name == "stream")
+		{
+			std::string::size_type j = value.find('\t');
+			P4Stream s;
+			s.stream = value.substr(0, j);
+			s.type = j == std::string::npos ? std::string() : value.substr(j + 1);
+			loaded.streams.push_back(s);
+		}
+	}
+
+	// Another key with the same hash
+	if (!keyMatches)
+		return false;
+
+	*this = loaded;
+	return true;
+}
+
+bool P4BootstrapCache::Save() const
+{
+	EnsureDirectory("./Library");
+	std::string path = GetPath();
+	std::ofstream out(path.c_str(), std::ios_base::out | std::ios_base::trunc);
+	if (!out.is_open())
+		return false;
+
+	out << kCacheHeader << "\n"
+		<< "key " << key << "\n"
+		<< "server " << serverIdentity << "\n"
+		<< "update " << specUpdate << "\n"
+		<< "root " << root << "\n";
+	for (P4Streams::const_iterator i = streams.begin(); i != streams.end(); ++i)
+		out << "stream " << i->stream << "\t" << i->type << "\n";
+	out.close();
+	return !out.fail();
+}
+
+// Servers without a configured server ID are recognized by address and root.
+// The version is included since an upgrade can change what the server reports.
+std::string P4BootstrapCache::GetServerIdentity(const P4Info& info)
+{
+	std::string id = info.serverID;
+	if (id.empty() && !info.serverAddress.empty())
+		id = info.serverAddress + " " + info.serverRoot;
+	if (id.empty() || info.serverVersion.empty())
+		return std::string();
+	return id + " " + info.serverVersion;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include "P4Info.h"
+#include "P4Stream.h"
+
+// Results of the commands run when connecting that only change when the
+// client spec or the server changes. Kept on disk per server, user and
+// workspace so that they need not be fetched again on the next connect.
+struct P4BootstrapCache
+{
+	std::string key;            // server, user and workspace
+	std::string serverIdentity; // see GetServerIdentity()
+	std::string specUpdate;     // "Update:" field of the client spec
+	std::string root;           // client root, known to be mapped in the workspace
+	P4Streams streams;
+
+	P4BootstrapCache(const std::string& port, const std::string& user, const std::string& client);
+
+	// True if the cached data belongs to the client spec as it is now
+	bool IsValidFor(const std::string& specUpdate, const std::string& root) const;
+
+	// Returns false if there is no cache for the key
+	bool Load();
+	bool Save() const;
+
+	static std::string GetServerIdentity(const P4Info& info);
+
+private:
+	std::string GetPath() const;
+};
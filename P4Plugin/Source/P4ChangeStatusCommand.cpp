@@ -1,4 +1,5 @@
 #include "Changes.h"
+#include "P4OpenedIndex.h"
 #include "P4StatusBaseCommand.h"
 
 class P4ChangeStatusCommand : public P4StatusBaseCommand
@@ -18,6 +19,18 @@ public:
 		
 		ChangelistRevision cl;
 		Conn() >> cl;
+
+		VersionedAssetList files;
+		if (task.GetOpenedIndex().GetFiles(task, cl, files))
+		{
+			Conn().BeginList();
+			for (VersionedAssetList::const_iterator i = files.begin(); i != files.end(); ++i)
+				Conn() << *i;
+			Conn().EndList();
+			Conn() << GetStatus();
+			Conn().EndResponse();
+			return true;
+		}
 		
 		// Compatibility with old perforce servers (<2008). -T is not supported, so just retrieve all the information for the requested files
 		std::string cmd = "fstat -W -e ";
@@ -1,5 +1,6 @@
 #include "Changes.h"
 #include "P4Command.h"
+#include "P4OpenedIndex.h"
 #include "P4Task.h"
 
 /*
@@ -25,8 +26,19 @@ public:
 		defaultItem.SetRevision(kDefaultListRevision);
 		
 		Conn() << defaultItem;
-		
-		task.CommandRun(cmd, this);
+
+		P4OpenedIndex& index = task.GetOpenedIndex();
+		m_Changes.clear();
+		if (index.GetChanges(m_Changes))
+		{
+			for (Changes::const_iterator i = m_Changes.begin(); i != m_Changes.end(); ++i)
+				Conn() << *i;
+		}
+		else if (task.CommandRun(cmd, this))
+		{
+			index.SetChanges(m_Changes);
+		}
+		m_Changes.clear();
 		Conn().EndList();
 		Conn() << GetStatus();
 
@@ -63,6 +75,10 @@ public:
 		item.SetDescription(d.substr(i));
 		item.SetRevision(d.substr(minLength-1, i - (minLength-1)));
 		Conn() << item;
+		m_Changes.push_back(item);
 	}
+
+private:
+	Changes m_Changes;
 	
 } cChanges("changes");
@@ -1,4 +1,5 @@
 #include "P4StatusCommand.h"
+#include "P4SubmitJobs.h"
 #include "P4Utility.h"
 #include "msgclient.h"
 #include "msgserver.h"
@@ -65,6 +66,10 @@ P4Command::P4Command(const char* name)
 	s_Commands->insert(std::make_pair(name,this));
 }
 
+P4Command::P4Command()
+{
+}
+
 const VCSStatus& P4Command::GetStatus() const
 { 
 	return m_Status; 
@@ -207,7 +212,7 @@ void P4Command::OutputBinary( const char *data, int length)
 void P4Command::OutputInfo( char level, const char *data )
 {
 	if (Conn().Log().GetLogLevel() != LOG_DEBUG)
-		Conn().Log().Info() << "level " << (int) level << ": " << data << Endl;
+		INFO_LOG(Conn().Log()) << "level " << (int) level << ": " << data << Endl;
 	std::stringstream ss;
 	ss << data << " (level " << (int) level << ")";	
 	Conn().InfoLine(ss.str());
@@ -240,6 +245,18 @@ void P4Command::RunAndGetStatus(P4Task& task, const VersionedAssetList& assetLis
 	c->Run(task, assetList, recursive, result);
 }
 
+bool P4Command::RejectSubmitting(P4Task& task, const VersionedAssetList& assetList)
+{
+	std::string changelist;
+	if (!task.GetSubmitJobs().IsSubmitting(assetList, changelist))
+		return false;
+
+	Conn().WarnLine("Files are being submitted in change " + changelist + ". Try again once the submit is done.", MARemote);
+	RunAndSendStatus(task, assetList);
+	Conn().EndResponse();
+	return true;
+}
+
 const char * kDelim = "_XUDELIMX_"; // magic delimiter
 
 static class P4WhereCommand : public P4Command
@@ -313,9 +330,12 @@ const std::vector<P4Command::Mapping>& P4Command::GetMappings(P4Task& task, cons
 	if (assets.empty())
 		return cWhere.mappings;
 
-	std::string localPaths = ResolvePaths(assets, kPathWild | kPathSkipFolders, "", kDelim);
+	PathListBuilder localPaths(assets, kPathWild | kPathSkipFolders, "", kDelim);
+	std::string cmd = "where ";
+	cmd.reserve(cmd.length() + localPaths.GetLength());
+	localPaths.AppendTo(cmd);
 	
-	task.CommandRun("where " + localPaths, &cWhere);
+	task.CommandRun(cmd, &cWhere);
 	Conn() << cWhere.GetStatus();
 	
 	if (cWhere.HasErrors())
@@ -19,6 +19,17 @@ class P4Command : public ClientUser
 {
 public:
 	virtual bool Run(P4Task& task, const CommandArgs& args) = 0;
+
+	// Commands that can be sent together with others without waiting for
+	// each reply implement Run() as BeginRun(), running the returned command
+	// line and EndRun() with the result. See P4Task::CommandRunPipelined().
+	// An empty command line means the command cannot be pipelined.
+	virtual std::string BeginRun(P4Task& task) { return std::string(); }
+	virtual bool EndRun(P4Task& task, bool ok) { return ok; }
+
+	// Commands that want their output as OutputStat() records instead of
+	// OutputInfo() lines. fstat and a few others always give records.
+	virtual bool IsTagged() const { return false; }
 	
 	const VCSStatus& GetStatus() const;
 	VCSStatus& GetStatus();
@@ -47,6 +58,9 @@ public:
 	
 protected:
 	P4Command(const char* name);
+
+	// For extra instances e.g. to run commands in parallel. Not found by LookupCommand().
+	P4Command();
 	static bool HandleOnlineStatusOnError(Error *err);
 
 	// Many of the derived classes need to send updated
@@ -54,6 +68,10 @@ protected:
 	static void RunAndSendStatus(P4Task& task, const VersionedAssetList& assetList);
 	static void RunAndGetStatus(P4Task& task, const VersionedAssetList& assetList, VersionedAssetList& result);
 
+	// Files being submitted in the background are left alone until the submit
+	// is done. Returns true if Unity has been told so and sent their state.
+	static bool RejectSubmitting(P4Task& task, const VersionedAssetList& assetList);
+
 	struct Mapping 
 	{
 		std::string depotPath;
@@ -1,5 +1,7 @@
 #include "P4Command.h"
 #include "P4Task.h"
+#include "P4ParallelTransfer.h"
+#include "P4SubmitJobs.h"
 #include <set>
 #include <algorithm>
 #include <iterator>
@@ -33,6 +35,17 @@ public:
 			logValue = "*";
 
 		Conn().Log().Info() << "Got config " << key << " = '" << logValue << "'" << Endl;
+
+		// A connect started in the background with the previous settings is of no use
+		bool connectionSetting = key == "vcPerforceUsername" || key == "vcPerforceWorkspace" ||
+			key == "projectPath" || key == "vcPerforcePassword" || key == "vcPerforceServer" ||
+			key == "vcPerforceTrackThreshold";
+		if (connectionSetting)
+			task.CancelBackgroundConnect();
+		// The rest, e.g. the pool, the log level and the tracer, is used by the
+		// connect thread so it has to be done first
+		else if (key != "pluginVersions" && key != "pluginTraits" && key != "vcPerforceHost")
+			task.FinishBackgroundConnect(true);
 		
 		// This command actually handles several commands all 
 		// concerning connecting to the perforce server
@@ -61,6 +74,59 @@ public:
 				level = LOG_FATAL;
 		    Conn().Log().SetLogLevel(level);
 		}
+		else if (key == "vcSharedTrace")
+		{
+			// Chrome trace event file which can be loaded in chrome://tracing or ui.perfetto.dev
+			if (value == "on" || value == "true" || value == "1")
+			{
+				if (!Conn().GetTracer().IsEnabled() && !Conn().GetTracer().Open("./Library/p4plugin-trace.json"))
+					Conn().WarnLine("Could not open trace file Library/p4plugin-trace.json", MAConfig);
+			}
+			else
+			{
+				Conn().GetTracer().Close();
+			}
+			Conn().Log().Info() << "Set tracing to " << (Conn().GetTracer().IsEnabled() ? "on" : "off") << Endl;
+		}
+		else if (key == "vcPerforceTrackThreshold")
+		{
+			// Milliseconds. Takes effect on the next connect.
+			task.SetTrackThreshold(atoi(value.c_str()));
+			Conn().Log().Info() << "Set server performance tracking threshold to " << task.GetTrackThreshold() << " ms" << Endl;
+		}
+		else if (key == "vcPerforceConnectionPoolSize")
+		{
+			// Connections for running read-only commands in parallel. Less than 2 disables it.
+			task.SetConnectionPoolSize(atoi(value.c_str()));
+			Conn().Log().Info() << "Set connection pool size to " << task.GetConnectionPoolSize() << Endl;
+		}
+		else if (key == "vcPerforceParallelThreads")
+		{
+			// Threads for syncing and submitting files. Less than 2 disables it.
+			task.GetParallelTransfer().SetThreads(atoi(value.c_str()));
+			Conn().Log().Info() << "Set parallel transfer threads to " << task.GetParallelTransfer().GetThreads() << Endl;
+		}
+		else if (key == "vcPerforceParallelBatch")
+		{
+			task.GetParallelTransfer().SetBatch(atoi(value.c_str()));
+			Conn().Log().Info() << "Set parallel transfer batch to " << task.GetParallelTransfer().GetBatch() << " files" << Endl;
+		}
+		else if (key == "vcPerforceParallelMinSize")
+		{
+			task.GetParallelTransfer().SetMinSize(atoi(value.c_str()));
+			Conn().Log().Info() << "Set parallel sync minimum file size to " << task.GetParallelTransfer().GetMinSize() << " bytes" << Endl;
+		}
+		else if (key == "vcPerforceIncrementalSync")
+		{
+			task.SetIncrementalSync(value == "on" || value == "true" || value == "1");
+			Conn().Log().Info() << "Set incremental sync to " << (task.IsIncrementalSync() ? "on" : "off") << Endl;
+		}
+		else if (key == "vcPerforceAsyncSubmit")
+		{
+			// Submit in the background, see P4SubmitJobs
+			task.GetSubmitJobs().SetEnabled(value == "on" || value == "true" || value == "1");
+			Conn().Log().Info() << "Set background submit to " << (task.GetSubmitJobs().IsEnabled() ? "on" : "off") << Endl;
+		}
 		else if (key == "vcPerforcePassword")
 		{
 			task.SetP4Password(value);
@@ -234,17 +300,33 @@ public:
 			Conn().DataLine("default");
 			Conn().DataLine(IntToString(kUpdating));
 			Conn().DataLine("default");
+
+			// Custom commands Unity can call, see P4Task::Dispatch()
+			Conn().DataLine("customCommands");
+			Conn().DataLine("1");
+			Conn().DataLine("submitStatus");                         // name
+			Conn().DataLine("Background Submit Status", MAConfig);   // label
+			Conn().DataLine("global");                               // context
 		}
 		else if (key == "end")
 		{
-			if (task.Reconnect())
-				task.Login();
+			// Keep the connection if the background connect made it
+			task.FinishBackgroundConnect(true);
+			if (!task.IsConnected() || !P4Task::IsOnline())
+			{
+				if (task.Reconnect())
+					task.Login();
+			}
 		}
 		else 
 		{
 			if(key != "vcPerforceHost")
 				Conn().WarnLine(ToString("Unknown config field set on version control plugin: ", key), MAConfig);
 		}
+
+		if (connectionSetting)
+			task.StartBackgroundConnect();
+		task.FinishBackgroundConnect(false);
 		Conn().EndResponse();
 		return true;
 	}
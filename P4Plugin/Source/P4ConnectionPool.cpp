@@ -0,0 +1,152 @@
+#include "P4ConnectionPool.h"
+#include "P4Task.h"
+#include "P4Command.h"
+#include "clientapi.h"
+
+P4ConnectionPool::P4ConnectionPool(P4Task& task)
+	: m_Task(task), m_Size(0), m_Commands(NULL), m_CommandClients(NULL), m_Captures(NULL), m_Next(0)
+{
+}
+
+P4ConnectionPool::~P4ConnectionPool()
+{
+	Reset();
+}
+
+void P4ConnectionPool::SetSize(int size)
+{
+	m_Size = size > 0 ? size : 0;
+	Reset();
+}
+
+void P4ConnectionPool::Reset()
+{
+	for (std::vector<ClientApi*>::iterator i = m_Clients.begin(); i != m_Clients.end(); ++i)
+	{
+		if (*i == NULL)
+			continue;
+		Error err;
+		(*i)->Final(&err);
+		delete *i;
+	}
+	m_Clients.clear();
+}
+
+bool P4ConnectionPool::IsReadOnly(const std::string& command)
+{
+	static const char* readOnly[] = { "fstat", "changes", "describe", "print", "where", "streams", 0 };
+	std::string name = command.substr(0, command.find(' '));
+	for (int i = 0; readOnly[i]; ++i)
+	{
+		if (name == readOnly[i])
+			return true;
+	}
+	return false;
+}
+
+void P4ConnectionPool::Run(const std::vector<std::string>& commands, const std::vector<P4Command*>& clients,
+						   std::vector<ConnectionCapture*>& captures, std::vector<bool>& results)
+{
+	captures.assign(commands.size(), NULL);
+	results.assign(commands.size(), false);
+	if (commands.empty())
+		return;
+
+	m_Commands = &commands;
+	m_CommandClients = &clients;
+	m_Captures = &captures;
+	m_Succeeded.assign(commands.size(), 0);
+	m_Next = 0;
+
+	size_t workerCount = commands.size() < (size_t)m_Size ? commands.size() : (size_t)m_Size;
+	if (m_Clients.size() < workerCount)
+		m_Clients.resize(workerCount, NULL);
+
+	// The calling thread works too
+	std::vector<Worker*> workers;
+	for (size_t i = 1; i < workerCount; ++i)
+	{
+		Worker* w = new Worker();
+		w->pool = this;
+		w->index = i;
+		if (!w->thread.Start(WorkerMain, w))
+		{
+			delete w;
+			break;
+		}
+		workers.push_back(w);
+	}
+	RunJobs(0);
+	for (std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); ++i)
+	{
+		(*i)->thread.Join();
+		delete *i;
+	}
+
+	for (size_t i = 0; i < commands.size(); ++i)
+		results[i] = m_Succeeded[i] != 0;
+	m_Commands = NULL;
+	m_CommandClients = NULL;
+	m_Captures = NULL;
+}
+
+void P4ConnectionPool::WorkerMain(void* data)
+{
+	Worker* w = (Worker*)data;
+	w->pool->RunJobs(w->index);
+}
+
+void P4ConnectionPool::RunJobs(size_t worker)
+{
+	Connection& conn = *m_Task.m_Connection;
+	for (;;)
+	{
+		long job = AtomicIncrement(&m_Next) - 1;
+		if (job >= (long)m_Commands->size())
+			break;
+
+		conn.BeginCapture("");
+		ClientApi* client = GetClient(worker);
+		if (client == NULL)
+		{
+			// The job is run afterwards on the main connection
+			delete conn.EndCapture();
+			break;
+		}
+
+		const std::string& command = (*m_Commands)[job];
+		conn.VerboseLine(command);
+		try
+		{
+			m_Succeeded[job] = m_Task.CommandRunOn(*client, command, (*m_CommandClients)[job], false);
+		}
+		catch (std::exception& e)
+		{
+			conn.Log().Notice() << "Pooled command failed: " << e.what() << Endl;
+		}
+		(*m_Captures)[job] = conn.EndCapture();
+	}
+}
+
+ClientApi* P4ConnectionPool::GetClient(size_t worker)
+{
+	ClientApi*& client = m_Clients[worker];
+	if (client != NULL && client->Dropped())
+	{
+		Error err;
+		client->Final(&err);
+		delete client;
+		client = NULL;
+	}
+
+	if (client == NULL)
+	{
+		client = new ClientApi();
+		if (!m_Task.InitPooledClient(*client))
+		{
+			delete client;
+			client = NULL;
+		}
+	}
+	return client;
+}
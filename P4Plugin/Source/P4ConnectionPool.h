@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Thread.h"
+
+class ClientApi;
+class P4Command;
+class P4Task;
+struct ConnectionCapture;
+
+// Extra connections to the server used to run read-only commands in parallel.
+// See P4Task::CommandRunParallel(). Connections are made when first needed
+// and kept until the settings change.
+class P4ConnectionPool
+{
+public:
+	P4ConnectionPool(P4Task& task);
+	~P4ConnectionPool();
+
+	// Number of connections. Less than two disables the pool.
+	void SetSize(int size);
+	int GetSize() const { return m_Size; }
+	bool IsEnabled() const { return m_Size > 1; }
+
+	// Close all connections
+	void Reset();
+
+	// Commands that do not change anything on the server or in the workspace
+	static bool IsReadOnly(const std::string& command);
+
+	// Run each command with its client on a connection of the pool. Returns when
+	// all are done. Output for Unity of command i is in captures[i] which the
+	// caller must send and delete. A NULL capture means the command was not run
+	// since no connection could be made.
+	void Run(const std::vector<std::string>& commands, const std::vector<P4Command*>& clients,
+			 std::vector<ConnectionCapture*>& captures, std::vector<bool>& results);
+
+private:
+	P4ConnectionPool(const P4ConnectionPool&);
+	P4ConnectionPool& operator=(const P4ConnectionPool&);
+
+	struct Worker
+	{
+		P4ConnectionPool* pool;
+		size_t index;
+		Thread thread;
+	};
+
+	static void WorkerMain(void* data);
+	void RunJobs(size_t worker);
+	ClientApi* GetClient(size_t worker);
+
+	P4Task& m_Task;
+	int m_Size;
+	std::vector<ClientApi*> m_Clients;
+
+	// The batch being run
+	const std::vector<std::string>* m_Commands;
+	const std::vector<P4Command*>* m_CommandClients;
+	std::vector<ConnectionCapture*>* m_Captures;
+	std::vector<char> m_Succeeded; // not vector<bool> which workers cannot write to at the same time
+	volatile long m_Next;
+};
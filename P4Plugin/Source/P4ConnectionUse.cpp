@@ -0,0 +1,65 @@
+#include "P4ConnectionUse.h"
+
+// How long BeginUse() sleeps before looking again should it miss a release
+const int RELEASE_WAIT_MS = 1000;
+
+P4ConnectionUse::P4ConnectionUse()
+	: m_Users(0), m_Busy(false), m_LastUse(GetMonotonicTime())
+{
+}
+
+void P4ConnectionUse::BeginUse()
+{
+	MutexLock lock(m_Mutex);
+	++m_Users;
+	while (m_Busy)
+	{
+		// The monitor gives up what it is doing once it sees the user
+		m_Mutex.Unlock();
+		m_Released.Wait(RELEASE_WAIT_MS);
+		m_Mutex.Lock();
+	}
+}
+
+void P4ConnectionUse::EndUse()
+{
+	MutexLock lock(m_Mutex);
+	--m_Users;
+	m_LastUse = GetMonotonicTime();
+}
+
+bool P4ConnectionUse::TryAcquire()
+{
+	MutexLock lock(m_Mutex);
+	if (m_Users > 0 || m_Busy)
+		return false;
+	m_Busy = true;
+	return true;
+}
+
+void P4ConnectionUse::Release()
+{
+	{
+		MutexLock lock(m_Mutex);
+		m_Busy = false;
+	}
+	m_Released.Set();
+}
+
+bool P4ConnectionUse::IsWanted()
+{
+	MutexLock lock(m_Mutex);
+	return m_Users > 0;
+}
+
+void P4ConnectionUse::MarkUsed(Microseconds now)
+{
+	MutexLock lock(m_Mutex);
+	m_LastUse = now;
+}
+
+bool P4ConnectionUse::IsIdleFor(Microseconds interval, Microseconds now)
+{
+	MutexLock lock(m_Mutex);
+	return now - m_LastUse >= interval;
+}
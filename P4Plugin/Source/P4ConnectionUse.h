@@ -0,0 +1,41 @@
+#pragma once
+#include "Metrics.h"
+#include "Thread.h"
+
+// Who is using the connection to the server: commands for Unity between
+// BeginUse() and EndUse(), or the health monitor between TryAcquire() and
+// Release(). The lock is only held to update the state, never while the
+// connection is used, so that a command can tell the monitor it is waiting.
+//
+// The connection counts as used when a command is done with it or when the
+// monitor says it did a round trip with MarkUsed(). Claiming it without
+// talking to the server does not count.
+class P4ConnectionUse
+{
+public:
+	P4ConnectionUse();
+
+	// BeginUse() waits for the monitor if it has the connection
+	void BeginUse();
+	void EndUse();
+
+	// Claim the connection for the monitor. Returns false if it is in use.
+	bool TryAcquire();
+	void Release();
+
+	// True if a command is waiting for the monitor to release the connection
+	bool IsWanted();
+
+	void MarkUsed(Microseconds now);
+	bool IsIdleFor(Microseconds interval, Microseconds now);
+
+private:
+	P4ConnectionUse(const P4ConnectionUse&);
+	P4ConnectionUse& operator=(const P4ConnectionUse&);
+
+	Mutex m_Mutex;
+	int m_Users;
+	bool m_Busy;
+	Microseconds m_LastUse;
+	Event m_Released;
+};
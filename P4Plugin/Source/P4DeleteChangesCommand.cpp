@@ -2,6 +2,17 @@
 #include "P4Command.h"
 #include "P4Task.h"
 
+// Deletes one changelist as part of a batch, see P4Task::CommandRunBatch()
+class P4DeleteChangeCommand : public P4Command
+{
+public:
+	P4DeleteChangeCommand(const std::string& command) : m_Command(command) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+	virtual std::string BeginRun(P4Task& task) { return m_Command; }
+private:
+	std::string m_Command;
+};
+
 class P4DeleteChangesCommand : public P4Command
 {
 public:
@@ -10,7 +21,6 @@ public:
 	{
 		ClearStatus();
 		Conn().Log().Info() << args[0] << "::Run()" << Endl;
-		std::string errorMessage;
 		
 		const std::string cmd = "change -d";
 		
@@ -25,13 +35,24 @@ public:
 			return true;
 		}
 		
-		std::string cl;
+		// The changelists are independent so one failing does not stop the others
+		std::vector<P4Command*> deletes;
 		for (ChangelistRevisions::const_iterator i = changes.begin(); i != changes.end(); ++i)
 		{
 			std::string rev = *i == kDefaultListRevision ? std::string("default") : *i;
-			std::string cmdr = cmd + " \"" + rev + "\"";
-			if (!task.CommandRun(cmdr, this))
-				break;
+			deletes.push_back(new P4DeleteChangeCommand(cmd + " \"" + rev + "\""));
+		}
+
+		std::vector<bool> results;
+		task.CommandRunBatch(deletes, results);
+
+		for (size_t i = 0; i < deletes.size(); ++i)
+		{
+			const VCSStatus& status = deletes[i]->GetStatus();
+			GetStatus().insert(status.begin(), status.end());
+			if (!results[i] && status.empty())
+				Conn().WarnLine("Delete of changelist " + changes[i] + " was not done");
+			delete deletes[i];
 		}
 		
 		// The OutputState and other callbacks will now output to stdout.
@@ -39,9 +60,9 @@ public:
 
 		Conn() << GetStatus();
 		
-		// @TODO: send changed assets
-		VersionedAssetList dummy;
-		Conn() << dummy;
+		// Only empty changelists can be deleted so no files have changed
+		VersionedAssetList none;
+		Conn() << none;
 		
 		Conn().EndResponse();
 		
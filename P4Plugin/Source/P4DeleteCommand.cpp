@@ -17,6 +17,9 @@ public:
 		VersionedAssetList incomingAssetList;
 		Conn() >> incomingAssetList;
 		
+		if (RejectSubmitting(task, incomingAssetList))
+			return true;
+
 		if ( incomingAssetList.empty() ) 
 		{
 			Conn().EndResponse();
@@ -103,7 +106,7 @@ public:
 	{
 		std::string paths = ResolvePaths(assetList, kPathWild | kPathSkipFolders);
 	
-		Conn().Log().Debug() << "Paths to revert before delete are: " << paths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths to revert before delete are: " << paths << Endl;
 	
 		if (paths.empty())
 			return;
@@ -0,0 +1,195 @@
+#include "P4DescribeCache.h"
+#include "FileSystem.h"
+#include "GZip.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+
+static const char* kCacheHeader = "p4plugin describe cache 1";
+
+// Bound the memory and disk used. The oldest changelists are dropped first
+// since they are the least likely to be looked at again.
+const size_t MAX_CHANGES = 1000;
+
+P4DescribeCache::P4DescribeCache()
+	: m_Enabled(false), m_Open(false), m_NextPending(0)
+{
+}
+
+void P4DescribeCache::SetEnabled(bool enabled)
+{
+	m_Enabled = enabled;
+	Clear();
+}
+
+void P4DescribeCache::Clear()
+{
+	m_Open = false;
+	m_Key.clear();
+	m_SpecUpdate.clear();
+	m_Changes.clear();
+	m_Pending.clear();
+	m_NextPending = 0;
+}
+
+void P4DescribeCache::Open(const std::string& key, const std::string& specUpdate)
+{
+	if (!m_Enabled || (m_Open && key == m_Key && specUpdate == m_SpecUpdate))
+		return;
+
+	Clear();
+	m_Key = key;
+	m_SpecUpdate = specUpdate;
+
+	// Without the update time a change of the view would go unnoticed
+	if (specUpdate.empty())
+		return;
+	m_Open = true;
+
+	if (!Load() || m_Changes.size() > MAX_CHANGES)
+	{
+		Trim();
+		Save();
+	}
+}
+
+bool P4DescribeCache::Get(const std::string& change, VersionedAssetList& files) const
+{
+	ChangeMap::const_iterator i = m_Changes.find(atoi(change.c_str()));
+	if (i == m_Changes.end())
+		return false;
+	files = i->second;
+	return true;
+}
+
+bool P4DescribeCache::Contains(const std::string& change) const
+{
+	return m_Changes.find(atoi(change.c_str())) != m_Changes.end();
+}
+
+void P4DescribeCache::Add(const std::string& change, const VersionedAssetList& files)
+{
+	int number = atoi(change.c_str());
+	if (!m_Open || number <= 0 || m_Changes.find(number) != m_Changes.end())
+		return;
+
+	m_Changes[number] = files;
+	Append(change, files);
+	Trim();
+}
+
+void P4DescribeCache::SetPending(const std::vector<std::string>& changes)
+{
+	m_Pending = changes;
+	m_NextPending = 0;
+}
+
+bool P4DescribeCache::TakePending(size_t count, std::vector<std::string>& changes)
+{
+	changes.clear();
+	if (!m_Open)
+		m_Pending.clear();
+	for (; m_NextPending < m_Pending.size() && changes.size() < count; ++m_NextPending)
+		changes.push_back(m_Pending[m_NextPending]);
+	return !changes.empty();
+}
+
+void P4DescribeCache::Trim()
+{
+	while (m_Changes.size() > MAX_CHANGES)
+		m_Changes.erase(m_Changes.begin());
+}
+
+std::string P4DescribeCache::GetPath() const
+{
+	std::stringstream ss;
+	ss << "./Library/p4plugin-describe-" << std::hex << std::setw(8) << std::setfill('0')
+	   << CRC32(0, (const unsigned char*)m_Key.data(), m_Key.length()) << ".txt";
+	return ss.str();
+}
+
+// Format after the header:
+// key <server, user and workspace>
+// update <"Update:" field of the client spec>
+// change <number>
+// file <state> <path>
+// ...
+bool P4DescribeCache::Load()
+{
+	std::ifstream in(GetPath().c_str());
+	if (!in.is_open())
+		return false;
+
+	std::string line;
+	if (!std::getline(in, line) || line != kCacheHeader)
+		return false;
+
+	bool keyMatches = false;
+	bool updateMatches = false;
+	VersionedAssetList* files = NULL;
+	while (std::getline(in, line))
+	{
+		std::string::size_type i = line.find(' ');
+		if (i == std::string::npos)
+			continue;
+		std::string name = line.substr(0, i);
+		std::string value = line.substr(i + 1);
+
+		if (name == "key")
+			keyMatches = value == m_Key;
+		else if (name == "update")
+			updateMatches = value == m_SpecUpdate;
+		else if (name == "change")
+			files = &m_Changes[atoi(value.c_str())];
+		else if (name == "file" && files != NULL)
+		{
+			std::string::size_type j = value.find(' ');
+			if (j != std::string::npos)
+				files->push_back(VersionedAsset(value.substr(j + 1), atoi(value.substr(0, j).c_str())));
+		}
+	}
+
+	// Another key with the same hash or another view
+	if (!keyMatches || !updateMatches)
+	{
+		m_Changes.clear();
+		return false;
+	}
+	return true;
+}
+
+bool P4DescribeCache::Save() const
+{
+	EnsureDirectory("./Library");
+	std::string path = GetPath();
+	std::ofstream out(path.c_str(), std::ios_base::out | std::ios_base::trunc);
+	if (!out.is_open())
+		return false;
+
+	out << kCacheHeader << "\n"
+		<< "key " << m_Key << "\n"
+		<< "update " << m_SpecUpdate << "\n";
+	for (ChangeMap::const_iterator i = m_Changes.begin(); i != m_Changes.end(); ++i)
+	{
+		out << "change " << i->first << "\n";
+		for (VersionedAssetList::const_iterator f = i->second.begin(); f != i->second.end(); ++f)
+			out << "file " << f->GetState() << " " << f->GetPath() << "\n";
+	}
+	out.close();
+	return !out.fail();
+}
+
+// Changelists are added one at a time so the file is not written all over again
+bool P4DescribeCache::Append(const std::string& change, const VersionedAssetList& files) const
+{
+	std::ofstream out(GetPath().c_str(), std::ios_base::out | std::ios_base::app);
+	if (!out.is_open())
+		return false;
+
+	out << "change " << change << "\n";
+	for (VersionedAssetList::const_iterator f = files.begin(); f != files.end(); ++f)
+		out << "file " << f->GetState() << " " << f->GetPath() << "\n";
+	out.close();
+	return !out.fail();
+}
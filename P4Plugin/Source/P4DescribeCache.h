@@ -0,0 +1,53 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "VersionedAsset.h"
+
+// Files of submitted changelists as told by describe and mapped to the
+// workspace by where. A submitted changelist never changes so they are kept
+// for the session and on disk per server, user and workspace. The mapping
+// depends on the client view which is why a change of the client spec drops
+// what is kept.
+class P4DescribeCache
+{
+public:
+	P4DescribeCache();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const { return m_Enabled; }
+	bool IsOpen() const { return m_Open; }
+
+	// Use the cache of the workspace given by key. Loads it from disk unless
+	// it is already in use. Does nothing when disabled.
+	void Open(const std::string& key, const std::string& specUpdate);
+
+	bool Get(const std::string& change, VersionedAssetList& files) const;
+	bool Contains(const std::string& change) const;
+	void Add(const std::string& change, const VersionedAssetList& files);
+
+	// Changelists to describe once Unity has no command for the plugin, see
+	// P4DescribeCommand::PrefetchWhenIdle(). TakePending() hands out up to
+	// count of them in the order given and returns false when none are left.
+	void SetPending(const std::vector<std::string>& changes);
+	bool TakePending(size_t count, std::vector<std::string>& changes);
+
+	void Clear();
+
+private:
+	std::string GetPath() const;
+	bool Load();
+	bool Save() const;
+	bool Append(const std::string& change, const VersionedAssetList& files) const;
+	void Trim();
+
+	typedef std::map<int, VersionedAssetList> ChangeMap;
+
+	bool m_Enabled;
+	bool m_Open;
+	std::string m_Key;
+	std::string m_SpecUpdate;
+	ChangeMap m_Changes;
+	std::vector<std::string> m_Pending;
+	size_t m_NextPending;
+};
@@ -0,0 +1,138 @@
+#include "P4DescribeCommand.h"
+#include "P4DescribeCache.h"
+#include "P4Utility.h"
+#include "Utility.h"
+
+// Describing many changelists up front takes a while on the first incoming
+// refresh of a workspace far behind. The newest ones are the likely ones to
+// be looked at.
+const size_t MAX_PREFETCH = 100;
+
+P4DescribeCommand::P4DescribeCommand(const std::string& change)
+	: m_Change(change), m_Pending(false)
+{
+}
+
+std::string P4DescribeCommand::BeginRun(P4Task& task)
+{
+	m_Files.clear();
+	m_Pending = false;
+	return "describe -s " + m_Change;
+}
+
+void P4DescribeCommand::OutputText(const char* data, int length)
+{
+	if (std::string(data, length).find("*pending*") != std::string::npos)
+		m_Pending = true;
+}
+
+void P4DescribeCommand::OutputInfo(char level, const char* data)
+{
+	std::string d(data);
+	if (d.find("*pending*") != std::string::npos)
+		m_Pending = true;
+
+	VersionedAsset asset;
+	if (StartsWith(d, "//") && ParseFile(d, asset))
+		m_Files.push_back(asset);
+}
+
+// The data format is:
+// //depot/...ProjectName/...#revnum action
+// where ... is an arbitrary deep path
+bool P4DescribeCommand::ParseFile(const std::string& d, VersionedAsset& asset)
+{
+	std::string::size_type i = d.rfind(" ");
+	if (i == std::string::npos || i < 2 || i+1 >= d.length()) // 2 == "//".length()
+		return false;
+
+	// strip revision specifier "#ddd"
+	std::string::size_type iPathEnd = d.rfind("#", i);
+	if (iPathEnd == std::string::npos)
+		iPathEnd = i;
+
+	asset = VersionedAsset(d.substr(0, iPathEnd));
+	std::string action = d.substr(i+1);
+	int state = action.empty() ? kNone : ActionToState(action,"","","");
+	asset.SetState(state);
+	asset.RemoveState(kCheckedOutLocal);
+	return true;
+}
+
+void P4DescribeCommand::Prefetch(P4Task& task, const std::vector<std::string>& changes)
+{
+	P4DescribeCache& cache = task.GetDescribeCache();
+	if (!cache.IsOpen())
+		return;
+
+	std::vector<P4Command*> clients;
+	for (std::vector<std::string>::const_iterator i = changes.begin(); i != changes.end(); ++i)
+	{
+		if (!cache.Contains(*i))
+			clients.push_back(new P4DescribeCommand(*i));
+	}
+	if (clients.empty())
+		return;
+
+	Conn().Log().Info() << "Prefetching files of " << clients.size() << " changelists" << Endl;
+	Conn().BeginCapture("");
+	std::vector<bool> results;
+	task.CommandRunBatch(clients, results);
+
+	// One where for the files of all the changelists, in order
+	std::vector<P4DescribeCommand*> described;
+	VersionedAssetList files;
+	for (size_t i = 0; i < clients.size(); ++i)
+	{
+		P4DescribeCommand* d = (P4DescribeCommand*)clients[i];
+		if (results[i] && !d->IsPending() && P4Task::IsOnline())
+		{
+			described.push_back(d);
+			files.insert(files.end(), d->m_Files.begin(), d->m_Files.end());
+		}
+	}
+
+	// A file of one changelist that cannot be mapped fails them all, so each
+	// is mapped on its own instead
+	bool mapped = files.empty() || MapToLocal(task, files);
+	VersionedAssetList::const_iterator f = files.begin();
+	for (std::vector<P4DescribeCommand*>::iterator i = described.begin(); i != described.end(); ++i)
+	{
+		if (mapped)
+		{
+			VersionedAssetList::const_iterator end = f + (*i)->m_Files.size();
+			cache.Add((*i)->m_Change, VersionedAssetList(f, end));
+			f = end;
+		}
+		else if (P4Task::IsOnline() && MapToLocal(task, (*i)->m_Files))
+		{
+			cache.Add((*i)->m_Change, (*i)->m_Files);
+		}
+	}
+
+	for (std::vector<P4Command*>::iterator i = clients.begin(); i != clients.end(); ++i)
+		delete *i;
+
+	// Only the metrics are kept. Whatever went wrong shows up again when the
+	// changelist is asked for.
+	ConnectionCapture* capture = Conn().EndCapture();
+	capture->output.clear();
+	Conn().SendCaptured(*capture);
+	delete capture;
+}
+
+void P4DescribeCommand::PrefetchWhenIdle(P4Task& task, const std::vector<std::string>& changes)
+{
+	P4DescribeCache& cache = task.GetDescribeCache();
+	if (!cache.IsOpen())
+		return;
+
+	std::vector<std::string> pending;
+	for (std::vector<std::string>::const_reverse_iterator i = changes.rbegin();
+		 i != changes.rend() && pending.size() < MAX_PREFETCH; ++i)
+	{
+		if (!cache.Contains(*i))
+			pending.push_back(*i);
+	}
+	cache.SetPending(pending);
+}
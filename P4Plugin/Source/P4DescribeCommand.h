@@ -0,0 +1,35 @@
+#pragma once
+#include "P4Command.h"
+
+// Runs 'describe -s' for a changelist, on its own or as part of a batch (see
+// P4Task::CommandRunBatch()), and keeps the files it lists in depot syntax.
+class P4DescribeCommand : public P4Command
+{
+public:
+	P4DescribeCommand(const std::string& change);
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+	virtual std::string BeginRun(P4Task& task);
+
+	void OutputText(const char* data, int length);
+	void OutputInfo(char level, const char* data);
+
+	const VersionedAssetList& GetFiles() const { return m_Files; }
+	bool IsPending() const { return m_Pending; }
+
+	// A file line of describe. Returns false if the line is not one.
+	static bool ParseFile(const std::string& line, VersionedAsset& asset);
+
+	// Describe the changelists not in the describe cache in one pipelined pass
+	// and map their files to the workspace with a single where. Output is not
+	// sent to Unity.
+	static void Prefetch(P4Task& task, const std::vector<std::string>& changes);
+
+	// Leave the Prefetch() of the newest changelists not in the describe cache
+	// to P4Task::RunIdleWork() so the response is not held up by it.
+	static void PrefetchWhenIdle(P4Task& task, const std::vector<std::string>& changes);
+
+private:
+	std::string m_Change;
+	VersionedAssetList m_Files;
+	bool m_Pending;
+};
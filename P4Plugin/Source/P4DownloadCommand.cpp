@@ -207,7 +207,7 @@ public:
 					tmpFile += "head";
 					std::string fileCmd = cmd + "\"" + tmpFile + "\" \"" + path + "#head\"";
 
-					Conn().Log().Info() << fileCmd << Endl;
+					INFO_LOG(Conn().Log()) << fileCmd << Endl;
 					if (!task.CommandRun(fileCmd, this))
 						break;
 					
@@ -227,7 +227,7 @@ public:
 						cConflictInfo.conflicts.clear();
 						std::string localPaths = ResolvePaths(assetList, kPathWild | kPathSkipFolders);
 						std::string rcmd = "resolve -o -n " + localPaths;
-						Conn().Log().Info() << rcmd << Endl;
+						INFO_LOG(Conn().Log()) << rcmd << Endl;
 
 						// Tell conflict info job about the paths we want so that it can get the case sensitivity correct.
 						cConflictInfo.conflicts.clear();
@@ -266,7 +266,7 @@ public:
 					{
 						std::string conflictFile = tmpFile + "conflicting";
 						std::string conflictCmd = cmd + "\"" + conflictFile + "\" \"" + ci->second.conflict + "\"";
-						Conn().Log().Info() << conflictCmd << Endl;
+						INFO_LOG(Conn().Log()) << conflictCmd << Endl;
 						if (!task.CommandRun(conflictCmd, this))
 							break;
 						
@@ -280,7 +280,7 @@ public:
 						{
 							baseFile = tmpFile + "base";
 							std::string baseCmd = cmd + "\"" + baseFile + "\" \"" + ci->second.base + "\"";
-							Conn().Log().Info() << baseCmd << Endl;
+							INFO_LOG(Conn().Log()) << baseCmd << Endl;
 							if (!task.CommandRun(baseCmd, this))
 								break;
 						}
@@ -26,7 +26,7 @@ public:
 		Conn() >> assetList;
 		std::string paths = ResolvePaths(assetList, kPathWild | kPathSkipFolders);
 	
-		Conn().Log().Debug() << "Paths resolved are: " << paths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths resolved are: " << paths << Endl;
 	
 		if (paths.empty())
 		{
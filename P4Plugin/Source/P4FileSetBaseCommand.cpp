@@ -17,6 +17,9 @@ bool P4FileSetBaseCommand::Run(P4Task& task, const CommandArgs& args)
 	VersionedAssetList assetList;
 	Conn() >> assetList;
 
+	if (RejectSubmitting(task, assetList))
+		return true;
+
 	if (Run(task, args, assetList))
 	{
 		// Stat the files to get the most recent state.
@@ -34,17 +37,19 @@ bool P4FileSetBaseCommand::Run(P4Task& task, const CommandArgs& args)
 bool P4FileSetBaseCommand::Run(P4Task& task, const CommandArgs& args, const VersionedAssetList& assetList)
 {
 	std::string cmd = SetupCommand(args);
-	std::string paths = ResolvePaths(assetList, GetResolvePathFlags());
+	PathListBuilder paths(assetList, GetResolvePathFlags());
 	
-	Conn().Log().Debug() << "Paths resolved are: " << paths << Endl;
+	DEBUG_LOG(Conn().Log()) << "Paths resolved are: " << paths << Endl;
 	
-	if (paths.empty())
+	if (paths.IsEmpty())
 	{
 		Conn().WarnLine("No paths in fileset perforce command", MARemote);
 		return false;
 	}
 	
-	cmd += " " + paths;
+	cmd.reserve(cmd.length() + 1 + paths.GetLength());
+	cmd += " ";
+	paths.AppendTo(cmd);
 	
 	task.CommandRun(cmd, this);
 	Conn() << GetStatus();
@@ -1,19 +1,61 @@
 #include "Utility.h"
+#include "FileSystem.h"
 #include "P4Command.h"
+#include "P4OpenedIndex.h"
+#include "P4ParallelTransfer.h"
+#include "P4StatusCommand.h"
+#include "P4Task.h"
 #include "P4Utility.h"
+#include "ProgressReporter.h"
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <vector>
 #include <time.h>
 
+// Runs 'sync -N' to learn how much a sync is going to transfer
+class P4SyncPreviewCommand : public P4Command
+{
+public:
+	P4SyncPreviewCommand() : m_Files(0), m_Bytes(0) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+
+	// Errors show up again on the sync itself
+	virtual void HandleError(Error* err) {}
+
+	virtual void OutputInfo(char level, const char* data)
+	{
+		// format e.g.:
+		// Server network estimates: files added/updated/deleted=1/2/0, bytes added/updated=1234/5678
+		std::string d(data);
+		unsigned int added = 0, updated = 0, deleted = 0;
+		unsigned long long bytesAdded = 0, bytesUpdated = 0;
+		std::string::size_type i = d.find("files added/updated/deleted=");
+		if (i != std::string::npos && sscanf(d.c_str() + d.find('=', i) + 1, "%u/%u/%u", &added, &updated, &deleted) == 3)
+			m_Files = added + updated + deleted;
+		i = d.find("bytes added/updated=");
+		if (i != std::string::npos && sscanf(d.c_str() + d.find('=', i) + 1, "%llu/%llu", &bytesAdded, &bytesUpdated) == 2)
+			m_Bytes = bytesAdded + bytesUpdated;
+	}
+
+	unsigned int m_Files;
+	unsigned long long m_Bytes;
+};
+
 class P4GetLatestCommand : public P4Command
 {
 public:
-	P4GetLatestCommand() : P4Command("getLatest") {}
+	P4GetLatestCommand() : P4Command("getLatest"), m_Progress(NULL), m_Bytes(0), m_IgnoreMissing(false), m_Tagged(false), m_RecheckAll(false) {}
 	
 	virtual bool Run(P4Task& task, const CommandArgs& args)
 	{
-		m_StartTime = time(0);
 		m_ProjectPath = task.GetProjectPath();
 
 		incomingAssetList.clear();
+		m_Recheck.clear();
+		m_RecheckAll = false;
+		m_LastPath.clear();
+		m_Bytes = 0;
 		ClearStatus();
 		Conn().Log().Info() << args[0] << "::Run()" << Endl;
 		
@@ -21,25 +63,82 @@ public:
 		
 		VersionedAssetList assetList;
 		Conn() >> assetList;
-		std::string paths = ResolvePaths(assetList, kPathWild | kPathRecursive);
+		PathListBuilder paths(assetList, kPathWild | kPathRecursive);
 		
-		Conn().Log().Debug() << "Paths resolved are: " << paths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths resolved are: " << paths << Endl;
 		
-		if (paths.empty())
+		if (paths.IsEmpty())
 		{
 			Conn().WarnLine("No paths in getlatest perforce command", MARemote);
 			Conn().EndResponse();
 			return true;
 		}
 		
-		cmd += " " + paths;
-		
-		task.CommandRun(cmd, this);
-		Conn() << GetStatus();
+		// Files are transferred on several connections when the server allows it
+		std::string parallel = task.GetParallelTransfer().GetSyncOption(task.GetP4Info());
+		if (!parallel.empty())
+		{
+			cmd += " " + parallel;
+			SetTransfer(&task.GetParallelTransfer());
+		}
+
+		std::string pathArgs;
+		pathArgs.reserve(paths.GetLength());
+		paths.AppendTo(pathArgs);
+
+		// The totals give real percentages. The size of each file is known
+		// once it is written, which with parallel transfer is not in order.
+		ProgressReporter progress(Conn());
+		P4SyncPreviewCommand preview;
+		if (!task.IsTestMode())
+			task.CommandRun("sync -N " + pathArgs, &preview);
+		progress.Begin(preview.m_Files, parallel.empty() ? preview.m_Bytes : 0);
+
+		// Tagged output tells enough about each file to know its state without
+		// asking the server again
+		m_Tagged = true;
+
+		// Requested files come before the rest of their folders when syncing
+		// incrementally
+		std::vector<VersionedAssetList> batches;
+		if (task.IsIncrementalSync())
+			MakeBatches(assetList, batches);
+
+		m_Progress = &progress;
+		Microseconds start = GetMonotonicTime();
+		if (batches.size() > 1)
+		{
+			SyncInBatches(task, cmd, batches);
+		}
+		else
+		{
+			task.CommandRun(cmd + " " + pathArgs, this);
+			Conn() << GetStatus();
+		}
+		SetTransfer(NULL);
+		m_Bytes += GetLocalFileSize(m_LastPath);
+		Conn().GetMetrics().AddTransfer((unsigned int)incomingAssetList.size(), m_Bytes, GetMonotonicTime() - start);
+		progress.Finish();
+		m_Progress = NULL;
 		
-		// Stat the files to get the most recent state.
-		// This could probably be optimized by reading the output of the command better
-		RunAndSendStatus(task, incomingAssetList);
+		if (batches.size() <= 1)
+		{
+			if (m_Tagged && !m_RecheckAll)
+			{
+				VersionedAssetList result;
+				GetSyncedStatus(task, incomingAssetList, result);
+				Conn().BeginList();
+				for (VersionedAssetList::const_iterator i = result.begin(); i != result.end(); ++i)
+					Conn() << *i;
+				Conn().EndList();
+			}
+			else
+			{
+				// Stat the files to get the most recent state
+				RunAndSendStatus(task, incomingAssetList);
+			}
+		}
+		m_Tagged = false;
 		
 		// The OutputState and other callbacks will now output to stdout.
 		// We just wrap up the communication here.
@@ -47,6 +146,170 @@ public:
 		return true;
 	}
 
+	// First the files asked for and their .meta files, including those of the
+	// folders asked for, then each folder. Nothing is made if no folder is asked for.
+	static void MakeBatches(const VersionedAssetList& assetList, std::vector<VersionedAssetList>& batches)
+	{
+		VersionedAssetList first;
+		VersionedAssetList folders;
+		for (VersionedAssetList::const_iterator i = assetList.begin(); i != assetList.end(); ++i)
+		{
+			if (i->IsFolder())
+			{
+				folders.push_back(*i);
+				std::string path = i->GetPath();
+				if (path.length() > 1)
+					first.push_back(VersionedAsset(path.substr(0, path.length() - 1) + ".meta"));
+				continue;
+			}
+			first.push_back(*i);
+			if (!i->IsMeta())
+				first.push_back(VersionedAsset(i->GetPath() + ".meta"));
+		}
+		if (folders.empty())
+			return;
+
+		RemoveOverlappingPaths(first, false);
+		batches.push_back(first);
+		for (VersionedAssetList::const_iterator i = folders.begin(); i != folders.end(); ++i)
+			batches.push_back(VersionedAssetList(1, *i));
+	}
+
+	// Sync the batches one after the other. The state of the files of each is
+	// sent as soon as it is done so that Unity can start on them.
+	void SyncInBatches(P4Task& task, const std::string& cmd, const std::vector<VersionedAssetList>& batches)
+	{
+		Conn().BeginList();
+		for (std::vector<VersionedAssetList>::const_iterator b = batches.begin(); b != batches.end(); ++b)
+		{
+			PathListBuilder paths(*b, kPathWild | kPathRecursive);
+			if (paths.IsEmpty())
+				continue;
+			std::string batchCmd = cmd + " ";
+			paths.AppendTo(batchCmd);
+
+			// The .meta files added to the first batch may not exist
+			m_IgnoreMissing = b == batches.begin();
+			size_t first = incomingAssetList.size();
+			m_Recheck.clear();
+			m_RecheckAll = false;
+			task.CommandRun(batchCmd, this);
+			m_IgnoreMissing = false;
+			if (incomingAssetList.size() > first || !m_Recheck.empty())
+			{
+				VersionedAssetList synced(incomingAssetList.begin() + first, incomingAssetList.end());
+				VersionedAssetList result;
+				GetSyncedStatus(task, synced, result);
+				for (VersionedAssetList::const_iterator i = result.begin(); i != result.end(); ++i)
+					Conn() << *i;
+				Conn().Flush();
+			}
+			if (!P4Task::IsOnline())
+				break;
+		}
+		Conn() << GetStatus();
+		Conn().EndList();
+	}
+
+	// State of the synced files. When the output is tagged only those the
+	// sync had anything to say about are fully stated on the server. The rest
+	// just get their open state.
+	void GetSyncedStatus(P4Task& task, const VersionedAssetList& synced, VersionedAssetList& result)
+	{
+		if (!m_Tagged || m_RecheckAll)
+		{
+			RunAndGetStatus(task, synced, result);
+			return;
+		}
+
+		result.clear();
+		VersionedAssetList rechecked;
+		if (!m_Recheck.empty())
+			RunAndGetStatus(task, m_Recheck, rechecked);
+
+		std::set<std::string> replaced;
+		for (VersionedAssetList::const_iterator i = rechecked.begin(); i != rechecked.end(); ++i)
+			replaced.insert(i->GetPath());
+		for (VersionedAssetList::const_iterator i = synced.begin(); i != synced.end(); ++i)
+		{
+			if (replaced.find(i->GetPath()) == replaced.end())
+				result.push_back(*i);
+		}
+		AddLocalState(result);
+		AddOpenState(task, result);
+		result.insert(result.end(), rechecked.begin(), rechecked.end());
+		task.GetOpenedIndex().Update(result);
+		m_Recheck.clear();
+	}
+
+	// The files are only all written once the sync is done, with parallel
+	// transfer not even in the order they are told about
+	static void AddLocalState(VersionedAssetList& assets)
+	{
+		for (VersionedAssetList::iterator i = assets.begin(); i != assets.end(); ++i)
+		{
+			if (!PathExists(i->GetPath()))
+				continue;
+			i->AddState(kLocal);
+			if (IsReadOnly(i->GetPath()))
+				i->AddState(kReadOnly);
+		}
+	}
+
+	// Sync output does not tell how the files are opened here or by others or
+	// if they are exclusive checkout. One fstat of just those fields does.
+	void AddOpenState(P4Task& task, VersionedAssetList& assets)
+	{
+		P4StatusCommand* c = dynamic_cast<P4StatusCommand*>(LookupCommand("status"));
+		if (!c || assets.empty() || !P4Task::IsOnline())
+			return;
+
+		VersionedAssetList opened;
+		c->RunOpenState(task, assets, opened);
+
+		const int kOpenStates = kCheckedOutLocal | kAddedLocal | kDeletedLocal | kMovedLocal | kLockedLocal | kConflicted |
+								kCheckedOutRemote | kDeletedRemote | kAddedRemote | kMovedRemote | kLockedRemote | kExclusiveCheckout;
+		std::map<std::string, int> states;
+		for (VersionedAssetList::const_iterator i = opened.begin(); i != opened.end(); ++i)
+			states[i->GetPath()] = i->GetState() & kOpenStates;
+		for (VersionedAssetList::iterator i = assets.begin(); i != assets.end(); ++i)
+		{
+			std::map<std::string, int>::const_iterator s = states.find(i->GetPath());
+			if (s != states.end())
+				i->SetState(i->GetState() | s->second);
+		}
+	}
+
+	virtual bool IsTagged() const { return m_Tagged; }
+
+	// The file a sync message is about, empty if it cannot tell.
+	// format e.g.:
+	// //depot/P4Test/Assets/Lars.meta#2 - is opened and not being changed
+	// //depot/P4Test/Assets/Lars.meta - must resolve #2 before submitting
+	// Can't clobber writable file /Users/foobar/UnityProjects/PerforceTest/P4Test/Assets/Lars.meta
+	static std::string GetMessagePath(const std::string& msg)
+	{
+		if (StartsWith(msg, "//"))
+		{
+			std::string path = msg.substr(0, msg.find(" - "));
+			return WildcardsRemove(path.substr(0, path.rfind('#')));
+		}
+		std::string::size_type i = msg.find(" file ");
+		if (i == std::string::npos || i + 6 >= msg.length())
+			return std::string();
+		return Replace(msg.substr(i + 6), "\\", "/");
+	}
+
+	// Files the sync did not just bring up to date are stated afterwards
+	void Recheck(const std::string& msg)
+	{
+		std::string path = GetMessagePath(msg);
+		if (path.empty())
+			m_RecheckAll = true; // stat everything as if the output was not tagged
+		else
+			m_Recheck.push_back(VersionedAsset(path));
+	}
+
 	virtual void HandleError( Error *err )
 	{
 		if ( err == 0 )
@@ -60,9 +323,35 @@ public:
 		value = TrimEnd(value, '\n');
 		
 		if (EndsWith(value, upToDate)) return; // ignore
+		if (m_IgnoreMissing && EndsWith(value, " - no such file(s).")) return;
 		
+		// Nothing was synced for paths not in the depot
+		if (m_Tagged && P4Task::IsOnline() && !EndsWith(value, " - no such file(s).") &&
+			!EndsWith(value, " - file(s) not in client view."))
+			Recheck(value);
 		P4Command::HandleError(err);
 	}
+
+	// Tagged output of each file synced
+	virtual void OutputStat( StrDict *varList )
+	{
+		StrPtr* clientFile = varList->GetVar("clientFile");
+		StrPtr* action = varList->GetVar("action");
+		if (clientFile == NULL || action == NULL)
+			return;
+
+		StrPtr* rev = varList->GetVar("rev");
+		std::string path = Replace(clientFile->Text(), "\\", "/");
+		Conn().VerboseLine(path);
+
+		// A deleted file is no longer in the workspace
+		incomingAssetList.push_back(VersionedAsset(path, *action == "deleted" ? kNone : kSynced, rev != NULL ? rev->Text() : ""));
+
+		StrPtr* fileSize = varList->GetVar("fileSize");
+		unsigned long long bytes = fileSize != NULL ? (unsigned long long)fileSize->Atoi64() : 0;
+		m_Bytes += bytes;
+		m_Progress->Step(bytes, StartsWith(path, m_ProjectPath) ? path.substr(m_ProjectPath.length()) : path);
+	}
 	
 
 	// Default handle of perforce info callbacks. Called by the default P4Command::Message() handler.
@@ -76,6 +365,13 @@ public:
 
 		Conn().VerboseLine(data);
 
+		// Files are only told about this way when the sync left them alone
+		if (m_Tagged)
+		{
+			Recheck(data);
+			return;
+		}
+
 		// format e.g.:
 		// //depot/P4Test/Assets/Lars.meta#2 - updating /Users/foobar/UnityProjects/PerforceTest/P4Test/Assets/Lars.meta
 		// //depot/P4Test/Assets/killme.txt#1 - added as /Users/foo....
@@ -96,11 +392,29 @@ public:
 		std::string path = d.substr(i1);
 		
 		incomingAssetList.push_back(VersionedAsset(path, kSynced, rev));
-		Conn().Progress(-1, time(0) - m_StartTime, StartsWith(path, m_ProjectPath) ? path.substr(m_ProjectPath.length()) : path);
+
+		// The file is written after this message so the previous one is done
+		unsigned long long bytes = GetLocalFileSize(m_LastPath);
+		m_Bytes += bytes;
+		m_LastPath = path;
+		m_Progress->Step(bytes, StartsWith(path, m_ProjectPath) ? path.substr(m_ProjectPath.length()) : path);
+	}
+
+	static unsigned long long GetLocalFileSize(const std::string& path)
+	{
+		if (path.empty() || !PathExists(path) || IsDirectory(path))
+			return 0;
+		return GetFileLength(path);
 	}
 
 	VersionedAssetList incomingAssetList;
-	time_t m_StartTime;
+	VersionedAssetList m_Recheck;
+	ProgressReporter* m_Progress;
+	std::string m_LastPath;
+	unsigned long long m_Bytes;
+	bool m_IgnoreMissing;
+	bool m_Tagged;
+	bool m_RecheckAll;
 	std::string m_ProjectPath;
 
 } cGetLatest;
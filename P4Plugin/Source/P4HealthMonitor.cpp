@@ -0,0 +1,230 @@
+#include "P4HealthMonitor.h"
+#include "P4Task.h"
+#include "clientapi.h"
+#include <exception>
+
+#if defined(_WINDOWS)
+#undef SetPort // renamed to SetPortW by windows.h
+#endif
+
+const int MONITOR_INTERVAL_MS = 1000;
+const int KEEP_ALIVE_INTERVAL_MS = 60 * 1000;
+const int MIN_BACKOFF_MS = 1000;
+const int MAX_BACKOFF_MS = 60 * 1000;
+
+P4HealthMonitor::P4HealthMonitor(P4Task& task)
+	: m_Task(task), m_Stop(0), m_Report(NULL),
+	  m_ServerDown(false), m_BackoffMs(MIN_BACKOFF_MS), m_NextProbe(0)
+{
+}
+
+P4HealthMonitor::~P4HealthMonitor()
+{
+	Stop();
+	delete m_Report;
+}
+
+void P4HealthMonitor::Start()
+{
+	if (m_Thread.IsStarted())
+		return;
+	m_Use.MarkUsed(GetMonotonicTime());
+	AtomicStore(&m_Stop, 0);
+	if (!m_Thread.Start(Main, this))
+		m_Task.m_Connection->Log().Notice() << "Could not start the connection health monitor" << Endl;
+}
+
+void P4HealthMonitor::Stop()
+{
+	if (!m_Thread.IsStarted())
+		return;
+	AtomicStore(&m_Stop, 1);
+	m_Wake.Set();
+	m_Thread.Join();
+}
+
+void P4HealthMonitor::BeginUse()
+{
+	m_Use.BeginUse();
+}
+
+void P4HealthMonitor::EndUse()
+{
+	m_Use.EndUse();
+}
+
+ConnectionCapture* P4HealthMonitor::TakeReport()
+{
+	MutexLock lock(m_ReportMutex);
+	ConnectionCapture* report = m_Report;
+	m_Report = NULL;
+	return report;
+}
+
+bool P4HealthMonitor::IsServerDown(std::string& reason)
+{
+	MutexLock lock(m_StateMutex);
+	if (m_ServerDown)
+		reason = m_DownReason;
+	return m_ServerDown;
+}
+
+void P4HealthMonitor::ReportUnreachable(const std::string& port, const std::string& reason)
+{
+	// Nobody would find out when it is back
+	if (!m_Thread.IsStarted())
+		return;
+
+	MutexLock lock(m_StateMutex);
+	if (!m_ServerDown || port != m_Port)
+	{
+		m_ServerDown = true;
+		m_Port = port;
+		m_BackoffMs = MIN_BACKOFF_MS;
+		m_NextProbe = GetMonotonicTime() + (Microseconds)m_BackoffMs * 1000;
+		m_Task.m_Connection->Log().Notice() << "Perforce server " << port << " is unreachable. Commands fail until it is back." << Endl;
+	}
+	m_DownReason = reason;
+}
+
+void P4HealthMonitor::ReportReachable()
+{
+	MutexLock lock(m_StateMutex);
+	if (m_ServerDown)
+		m_Task.m_Connection->Log().Notice() << "Perforce server " << m_Port << " is reachable again" << Endl;
+	m_ServerDown = false;
+	m_BackoffMs = MIN_BACKOFF_MS;
+}
+
+void P4HealthMonitor::Main(void* data)
+{
+	((P4HealthMonitor*)data)->Run();
+}
+
+void P4HealthMonitor::Run()
+{
+	while (!AtomicLoad(&m_Stop))
+	{
+		m_Wake.Wait(MONITOR_INTERVAL_MS);
+		if (AtomicLoad(&m_Stop))
+			break;
+
+		try
+		{
+			bool probe = false;
+			{
+				MutexLock lock(m_StateMutex);
+				probe = m_ServerDown && GetMonotonicTime() >= m_NextProbe;
+			}
+			if (probe)
+				CheckServer();
+			else
+				KeepAlive();
+		}
+		catch (std::exception& e)
+		{
+			m_Task.m_Connection->Log().Notice() << "Connection health monitor: " << e.what() << Endl;
+		}
+	}
+}
+
+void P4HealthMonitor::AddReport(ConnectionCapture* capture)
+{
+	if (capture == NULL)
+		return;
+	MutexLock lock(m_ReportMutex);
+	if (m_Report == NULL)
+	{
+		m_Report = capture;
+		return;
+	}
+	m_Report->output += capture->output;
+	m_Report->metrics.Add(capture->metrics);
+	delete capture;
+}
+
+// A plain connect tells if anything is listening without needing a login
+bool P4HealthMonitor::Probe(const std::string& port)
+{
+	ClientApi client;
+	client.SetPort(port.c_str());
+	Error err;
+	client.Init(&err);
+	bool reachable = !err.Test() || !IsConnectFailure(err);
+	Error finalErr;
+	client.Final(&finalErr);
+	return reachable;
+}
+
+void P4HealthMonitor::CheckServer()
+{
+	std::string port;
+	{
+		MutexLock lock(m_StateMutex);
+		port = m_Port;
+	}
+
+	if (!Probe(port))
+	{
+		MutexLock lock(m_StateMutex);
+		m_BackoffMs = m_BackoffMs * 2 > MAX_BACKOFF_MS ? MAX_BACKOFF_MS : m_BackoffMs * 2;
+		m_NextProbe = GetMonotonicTime() + (Microseconds)m_BackoffMs * 1000;
+		return;
+	}
+
+	ReportReachable();
+
+	// Otherwise the command running reconnects by itself
+	if (m_Use.TryAcquire())
+	{
+		Reconnect();
+		m_Use.Release();
+	}
+}
+
+void P4HealthMonitor::KeepAlive()
+{
+	if (!m_Use.TryAcquire())
+		return;
+
+	if (m_Use.IsIdleFor((Microseconds)KEEP_ALIVE_INTERVAL_MS * 1000, GetMonotonicTime()) &&
+		m_Task.IsConnected() && P4Task::IsOnline())
+	{
+		m_Task.m_Connection->BeginCapture("keepAlive");
+		try
+		{
+			if (!m_Task.KeepAlive())
+			{
+				// A command waiting for the connection reconnects by itself
+				m_Task.m_Connection->Log().Notice() << "Lost the idle connection to the Perforce server" << Endl;
+				if (!m_Use.IsWanted() && m_Task.Reconnect() && !m_Use.IsWanted())
+					m_Task.Login();
+			}
+		}
+		catch (std::exception& e)
+		{
+			m_Task.m_Connection->Log().Notice() << "Keep alive failed: " << e.what() << Endl;
+		}
+		AddReport(m_Task.m_Connection->EndCapture());
+		m_Use.MarkUsed(GetMonotonicTime());
+	}
+	m_Use.Release();
+}
+
+// Called with the connection acquired. A command waiting for the connection
+// logs in by itself.
+void P4HealthMonitor::Reconnect()
+{
+	m_Task.m_Connection->BeginCapture("healthMonitor");
+	try
+	{
+		if (!m_Use.IsWanted() && m_Task.Reconnect() && !m_Use.IsWanted())
+			m_Task.Login();
+	}
+	catch (std::exception& e)
+	{
+		m_Task.m_Connection->Log().Notice() << "Reconnect failed: " << e.what() << Endl;
+	}
+	AddReport(m_Task.m_Connection->EndCapture());
+	m_Use.MarkUsed(GetMonotonicTime());
+}
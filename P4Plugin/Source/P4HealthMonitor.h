@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include "Metrics.h"
+#include "P4ConnectionUse.h"
+#include "Thread.h"
+
+class P4Task;
+struct ConnectionCapture;
+
+// Watches the connection to the server from a background thread.
+//
+// An idle connection gets a cheap round trip now and then so that it is not
+// dropped. Once the server has been found unreachable it is probed with a
+// plain connect, backing off exponentially, and reconnected to when it comes
+// back. Until then commands fail at once instead of each one waiting for the
+// network timeout.
+//
+// The monitor only uses the connection while nobody else does, see BeginUse(),
+// and gives up a reconnect between its steps once somebody is waiting for it.
+// What it would have told Unity is kept until the main thread asks for it
+// with TakeReport().
+class P4HealthMonitor
+{
+public:
+	P4HealthMonitor(P4Task& task);
+	~P4HealthMonitor();
+
+	void Start();
+	void Stop();
+
+	// Anyone using the connection other than the monitor does so between
+	// BeginUse() and EndUse(). BeginUse() waits for the monitor if it is busy.
+	void BeginUse();
+	void EndUse();
+
+	// Output of the reconnects done by the monitor since last called or NULL.
+	// The caller must send it to Unity and delete it.
+	ConnectionCapture* TakeReport();
+
+	// True while the server is known to be unreachable
+	bool IsServerDown(std::string& reason);
+
+	// Outcome of connecting to the server at port
+	void ReportUnreachable(const std::string& port, const std::string& reason);
+	void ReportReachable();
+
+private:
+	P4HealthMonitor(const P4HealthMonitor&);
+	P4HealthMonitor& operator=(const P4HealthMonitor&);
+
+	static void Main(void* data);
+	void Run();
+
+	void AddReport(ConnectionCapture* capture);
+
+	bool Probe(const std::string& port);
+	void CheckServer();
+	void KeepAlive();
+	void Reconnect();
+
+	P4Task& m_Task;
+	Thread m_Thread;
+	Event m_Wake;
+	volatile long m_Stop;
+
+	P4ConnectionUse m_Use;
+
+	// Guards the report
+	Mutex m_ReportMutex;
+	ConnectionCapture* m_Report;
+
+	// Guards the server state
+	Mutex m_StateMutex;
+	bool m_ServerDown;
+	std::string m_DownReason;
+	std::string m_Port;
+	int m_BackoffMs;
+	Microseconds m_NextProbe;
+};
@@ -1,17 +1,20 @@
 #include "Utility.h"
 #include "Changes.h"
 #include "P4Command.h"
+#include "P4DescribeCache.h"
+#include "P4DescribeCommand.h"
 #include "P4Utility.h"
 
 class P4IncomingChangeAssetsCommand : public P4Command
 {
 public:
-	P4IncomingChangeAssetsCommand(const char* name) : P4Command(name) {}
+	P4IncomingChangeAssetsCommand(const char* name) : P4Command(name), m_Pending(false) {}
 	virtual bool Run(P4Task& task, const CommandArgs& args)
 	{
 		ClearStatus();
 		m_ProjectPath = task.GetP4Root();
 		m_Result.clear();
+		m_Pending = false;
 
 		ChangelistRevision cl;
 		Conn() >> cl;
@@ -29,6 +32,18 @@ public:
 		Conn().Log().Debug() << "Project path is " << m_ProjectPath << Endl;
 		
 		std::string rev = cl == kDefaultListRevision ? std::string("default") : cl;
+
+		// Submitted changelists never change
+		P4DescribeCache& cache = task.GetDescribeCache();
+		if (cl != kDefaultListRevision && cache.Get(rev, m_Result))
+		{
+			Conn().Log().Info() << "Files of changelist " << rev << " known from before" << Endl;
+			Conn() << m_Result;
+			m_Result.clear();
+			Conn().EndResponse();
+			return true;
+		}
+
 		const std::string cmd = std::string("describe -s ") + rev;
 		
 		task.CommandRun(cmd, this);
@@ -43,6 +58,9 @@ public:
 			return true;
 		}
 
+		if (cl != kDefaultListRevision && !m_Pending && !HasErrors())
+			cache.Add(rev, m_Result);
+
 		Conn() << m_Result;
 		m_Result.clear();
 		Conn() << GetStatus();
@@ -54,46 +72,37 @@ public:
 	
 	void OutputText( const char *data, int length)
 	{
-		Conn().Log().Debug() << "OutputText()" << Endl;
+		DEBUG_LOG(Conn().Log()) << "OutputText()" << Endl;
+		if (std::string(data, length).find("*pending*") != std::string::npos)
+			m_Pending = true;
 	}
 	
     // Called once per asset 
 	void OutputInfo( char level, const char *data )
     {
-		// The data format is:
-		// //depot/...ProjectName/...#revnum action
-		// where ... is an arbitrary deep path
-		// to get the filesystem path we remove the append this
-		// to the Root path.
+		// See P4DescribeCommand::ParseFile() for the format
 		
 		if (Conn().Log().GetLogLevel() != LOG_DEBUG)
-			Conn().Log().Info() << "OutputInfo: " << data << Endl;
+			INFO_LOG(Conn().Log()) << "OutputInfo: " << data << Endl;
 		
 		std::string d(data);
 		Conn().VerboseLine(d);
-		std::string::size_type i = d.rfind(" ");
-		if (i == std::string::npos || i < 2 || i+1 >= d.length()) // 2 == "//".length()
+		if (d.find("*pending*") != std::string::npos)
+			m_Pending = true;
+
+		VersionedAsset a;
+		if (!P4DescribeCommand::ParseFile(d, a))
 		{
 			Conn().WarnLine(std::string("Invalid change asset - ") + d);
 			return;
 		}
 		
-		// strip revision specifier "#ddd"
-		std::string::size_type iPathEnd = d.rfind("#", i);
-		if (iPathEnd == std::string::npos)
-			iPathEnd = i;
-		
-		VersionedAsset a(d.substr(0, iPathEnd));
-		std::string action = d.substr(i+1);
-		int state = action.empty() ? kNone : ActionToState(action,"","","");
-		a.SetState(state);
-		a.RemoveState(kCheckedOutLocal);
-		
 		m_Result.push_back(a);
 	}
 	
 private:
 	std::string m_ProjectPath;
 	VersionedAssetList m_Result;
+	bool m_Pending;
 	
 } cIncomingChangeAssets("incomingChangeAssets");
@@ -1,5 +1,6 @@
 #include "Changes.h"
 #include "P4Command.h"
+#include "P4DescribeCommand.h"
 #include "P4Task.h"
 #include <set>
 #include <sstream>
@@ -13,6 +14,7 @@ class P4IncomingCommand : public P4Command
 {
 public:
 	P4IncomingCommand(const char* name) : P4Command(name) {}
+	P4IncomingCommand() {}
 	virtual bool Run(P4Task& task, const CommandArgs& args)
 	{		
 		// Old version used "changes -l -s submitted ...#>have" but that does not include submitted
@@ -46,20 +48,33 @@ public:
 			return true;
 		}
 		
-		// Fetch the descriptions for the incoming changelists.
+		// Fetch the descriptions for the incoming changelists. They are independent so
+		// they run in parallel when possible, each with a command of its own.
 		// @TODO: could save some roundtrips by make only one changes call for each sequence of 
 		//        changelist ids.
+		std::vector<std::string> commands;
+		std::vector<P4Command*> clients;
+		std::vector<std::string> changes;
 		std::stringstream ss;
 		for (std::set<int>::const_iterator i = m_Changelists.begin(); i != m_Changelists.end(); ++i) 
 		{
+			ss.str("");
+			ss << *i;
+			changes.push_back(ss.str());
+
 			ss.str("");
 			ss << "changes -l -s submitted \"@" << *i << ",@" << *i << "\"";
-			Conn().Log().Info() << "    " << ss.str() << Endl;
-			
-			if (!task.CommandRun(ss.str(), this))
-			{
-				break;
-			}
+			INFO_LOG(Conn().Log()) << "    " << ss.str() << Endl;
+			commands.push_back(ss.str());
+			clients.push_back(new P4IncomingCommand());
+		}
+
+		std::vector<bool> results;
+		task.CommandRunParallel(commands, clients, results);
+		for (std::vector<P4Command*>::iterator i = clients.begin(); i != clients.end(); ++i)
+		{
+			GetStatus().insert((*i)->GetStatus().begin(), (*i)->GetStatus().end());
+			delete *i;
 		}
 		
 		m_Changelists.clear();
@@ -69,6 +84,9 @@ public:
 		Conn().EndList();
 		Conn() << GetStatus();
 		Conn().EndResponse();
+
+		// Expanding a changelist in Unity is then answered without asking the server
+		P4DescribeCommand::PrefetchWhenIdle(task, changes);
 		
 		return true;
 	}
@@ -126,7 +144,7 @@ public:
 			else if (key == "haveRev" && value != "none")
 				haveRev = atoi(val.Text());
 			else 
-				Conn().Log().Debug() << "Warning: skipping unknown stat variable: " << key << " : " << val.Text() << Endl;
+				DEBUG_LOG(Conn().Log()) << "Warning: skipping unknown stat variable: " << key << " : " << val.Text() << Endl;
 		}
 
 		Conn().VerboseLine(verboseLine);
@@ -9,6 +9,7 @@ struct P4Info
 	std::string peerAddress;
 	std::string clientAddress;
 	std::string serverAddress;
+	std::string serverID;
 	std::string serverRoot;
 	std::string serverVersion;
 	std::string serverLicense;
@@ -8,6 +8,7 @@ static const char* kCurrentDir = "Current directory: ";
 static const char* kPeerAddr = "Peer address: ";
 static const char* kClientAddr = "Client address: ";
 static const char* kServerAddr = "Server address: ";
+static const char* kServerID = "Server ID: ";
 static const char* kServerRoot = "Server root: ";
 static const char* kServerVersion = "Server version: ";
 static const char* kServerLicense = "Server license: ";
@@ -18,12 +19,22 @@ class P4InfoCommand : public P4Command
 public:
 	P4InfoCommand(const char* name) : P4Command(name) { }
 	virtual bool Run(P4Task& task, const CommandArgs& args)
+	{
+		std::string cmd = BeginRun(task);
+		return EndRun(task, task.CommandRun(cmd, this));
+	}
+
+	virtual std::string BeginRun(P4Task& task)
 	{
 		ClearStatus();
 		m_Info = P4Info();
 		m_Info.clientIsKnown = true;
+		return "info";
+	}
 
-		if (!task.CommandRun("info", this))
+	virtual bool EndRun(P4Task& task, bool ok)
+	{
+		if (!ok)
 		{
 			std::string errorMessage = GetStatusMessage();			
 			Conn().Log().Fatal() << errorMessage << Endl;
@@ -61,6 +72,7 @@ public:
 			if (ExtractInfo(line, kPeerAddr, m_Info.peerAddress)) continue;
 			if (ExtractInfo(line, kClientAddr, m_Info.clientAddress)) continue;
 			if (ExtractInfo(line, kServerAddr, m_Info.serverAddress)) continue;
+			if (ExtractInfo(line, kServerID, m_Info.serverID)) continue;
 			if (ExtractInfo(line, kServerRoot, m_Info.serverRoot)) continue;
 			if (ExtractInfo(line, kServerVersion, m_Info.serverVersion)) continue;
 			if (ExtractInfo(line, kServerLicense, m_Info.serverLicense)) continue;
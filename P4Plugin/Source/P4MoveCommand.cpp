@@ -2,6 +2,73 @@
 #include "P4Command.h"
 #include "P4Task.h"
 #include "P4Utility.h"
+#include "Thread.h"
+
+// Moves one src,dest pair as part of a batch, see P4Task::CommandRunBatch()
+class P4MovePairCommand : public P4Command
+{
+public:
+	P4MovePairCommand(const std::string& command) : m_Command(command) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+	virtual std::string BeginRun(P4Task& task) { return m_Command; }
+private:
+	std::string m_Command;
+};
+
+typedef std::vector<std::pair<std::string, std::string> > LocalMoves;
+
+struct LocalMoveJobs
+{
+	const LocalMoves* moves;
+	std::vector<char> moved; // not vector<bool> which threads cannot write to at the same time
+	volatile long next;
+};
+
+static void LocalMoveWorker(void* data)
+{
+	LocalMoveJobs* jobs = (LocalMoveJobs*)data;
+	for (;;)
+	{
+		long i = AtomicIncrement(&jobs->next) - 1;
+		if (i >= (long)jobs->moves->size())
+			break;
+		const std::pair<std::string, std::string>& move = (*jobs->moves)[i];
+		jobs->moved[i] = MoveAFile(move.first, move.second) ? 1 : 0;
+	}
+}
+
+// Renames are cheap but a move to another volume copies the file, so many
+// moves are spread over a few threads.
+static void MoveLocalFiles(const LocalMoves& moves, std::vector<char>& moved)
+{
+	const size_t kMaxThreads = 4;
+	const size_t kMovesPerThread = 16;
+
+	LocalMoveJobs jobs;
+	jobs.moves = &moves;
+	jobs.moved.assign(moves.size(), 0);
+	jobs.next = 0;
+
+	// The calling thread works too
+	std::vector<Thread*> threads;
+	for (size_t i = 1; i < kMaxThreads && i * kMovesPerThread < moves.size(); ++i)
+	{
+		Thread* t = new Thread();
+		if (!t->Start(LocalMoveWorker, &jobs))
+		{
+			delete t;
+			break;
+		}
+		threads.push_back(t);
+	}
+	LocalMoveWorker(&jobs);
+	for (std::vector<Thread*>::iterator i = threads.begin(); i != threads.end(); ++i)
+	{
+		(*i)->Join();
+		delete *i;
+	}
+	moved.swap(jobs.moved);
+}
 
 class P4MoveCommand : public P4Command
 {
@@ -17,6 +84,9 @@ public:
 		VersionedAssetList assetList;
 		Conn() >> assetList;
 		
+		if (RejectSubmitting(task, assetList))
+			return true;
+
 		if ( assetList.empty() ) 
 		{
 			Conn().EndResponse();
@@ -46,7 +116,7 @@ public:
 			
 			if (editable)
 			{
-				Conn().Log().Debug() << "Already editable source " << src.GetPath() << Endl;
+				DEBUG_LOG(Conn().Log()) << "Already editable source " << src.GetPath() << Endl;
 			}
 			else
 			{
@@ -63,49 +133,61 @@ public:
 			task.CommandRun("edit " + noLocalFileMoveFlag + editPaths, this);
 		}
 
-		b = assetList.begin();
-		e = b;
-
+		// One command per pair. They are pipelined and a pair that fails does
+		// not stop the others.
 		VersionedAssetList targetAssetList;
-		while (!HasErrors() && b != assetList.end())
+		std::vector<P4Command*> moves;
+		if (!HasErrors())
 		{
-			e += 2;
-			
-			const VersionedAsset& src = *b;
-			const VersionedAsset& dest = *(b+1);
-
-			targetAssetList.push_back(dest);
-			
-			std::string paths = ResolvePaths(b, e, kPathWild | kPathRecursive);
-			
-			if (!task.CommandRun("move " + noLocalFileMoveFlag + paths, this))
+			for (b = assetList.begin(); b != assetList.end(); b += 2)
 			{
-				break;
+				targetAssetList.push_back(*(b+1));
+				moves.push_back(new P4MovePairCommand("move " + noLocalFileMoveFlag + ResolvePaths(b, b + 2, kPathWild | kPathRecursive)));
 			}
-			
+		}
+
+		std::vector<bool> results;
+		task.CommandRunBatch(moves, results);
+
+		LocalMoves localMoves;
+		for (size_t i = 0; i < moves.size(); ++i)
+		{
+			const VersionedAsset& src = assetList[2 * i];
+			const VersionedAsset& dest = assetList[2 * i + 1];
+
+			const VCSStatus& status = moves[i]->GetStatus();
+			GetStatus().insert(status.begin(), status.end());
+			if (!results[i] && status.empty())
+				Conn().WarnLine("Move of " + src.GetPath() + " to " + dest.GetPath() + " was not done");
+			delete moves[i];
+			moves[i] = NULL;
+
 			// Make the actual file system move if perforce didn't do it ie. in
 			// the case of an empty folder rename or a non versioned asset/folder move/rename
-			if (!PathExists(dest.GetPath()))
-			{
-				// Move the file
-				if (!MoveAFile(src.GetPath(), dest.GetPath()))
-				{
-					std::string errorMessage = "Error moving file ";
-					errorMessage += src.GetPath();
-					errorMessage += " to ";
-					errorMessage += dest.GetPath();
-					Conn().WarnLine(errorMessage);
-				}
-			}
+			if (results[i] && !PathExists(dest.GetPath()))
+				localMoves.push_back(std::make_pair(src.GetPath(), dest.GetPath()));
+		}
 
-			// Delete move folder src since perforce leaves around empty folders.
-			// This only works because unity will not send embedded moves.
-			if (src.IsFolder() && IsDirectory(src.GetPath()))
-			{
-				DeleteRecursive(src.GetPath());
-			}
+		std::vector<char> moved;
+		MoveLocalFiles(localMoves, moved);
+		for (size_t i = 0; i < localMoves.size(); ++i)
+		{
+			if (moved[i])
+				continue;
+			std::string errorMessage = "Error moving file ";
+			errorMessage += localMoves[i].first;
+			errorMessage += " to ";
+			errorMessage += localMoves[i].second;
+			Conn().WarnLine(errorMessage);
+		}
 
-			b = e;
+		// Delete move folder src since perforce leaves around empty folders.
+		// This only works because unity will not send embedded moves.
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const VersionedAsset& src = assetList[2 * i];
+			if (results[i] && src.IsFolder() && IsDirectory(src.GetPath()))
+				DeleteRecursive(src.GetPath());
 		}
 		
 		// We just wrap up the communication here.
@@ -0,0 +1,289 @@
+#include "P4OpenedIndex.h"
+#include "FileSystem.h"
+#include "P4StatusBaseCommand.h"
+#include "P4Task.h"
+#include "P4Utility.h"
+#include "Utility.h"
+
+// How long the index is trusted before the opened files are stated again
+const Microseconds VALIDATE_INTERVAL_US = (Microseconds)30 * 1000 * 1000;
+
+static std::string GetOpened(StrDict* varList)
+{
+	StrPtr* change = varList->GetVar("change");
+	StrPtr* action = varList->GetVar("action");
+	return std::string(change != NULL ? change->Text() : "") + " " + (action != NULL ? action->Text() : "");
+}
+
+static bool IsOpened(const VersionedAsset& asset)
+{
+	return asset.HasState(kCheckedOutLocal | kAddedLocal | kDeletedLocal);
+}
+
+// Lists the files opened in the workspace
+class P4OpenedCommand : public P4Command
+{
+public:
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+	virtual bool IsTagged() const { return true; }
+
+	virtual void OutputStat(StrDict* varList)
+	{
+		StrPtr* depotFile = varList->GetVar("depotFile");
+		if (depotFile != NULL)
+			m_Files[depotFile->Text()] = GetOpened(varList);
+	}
+
+	virtual void HandleError(Error* err)
+	{
+		if (err == 0)
+			return;
+
+		StrBuf buf;
+		err->Fmt(&buf);
+		if (EndsWith(TrimEnd(std::string(buf.Text()), '\n'), " - file(s) not opened on this client."))
+			return; // nothing opened is fine
+
+		P4Command::HandleError(err);
+	}
+
+	std::map<std::string, std::string> m_Files;
+};
+
+// State of opened files with the change they are opened in
+class P4OpenedStatCommand : public P4StatusBaseCommand
+{
+public:
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+
+	bool Run(P4Task& task, const VersionedAssetList& assets)
+	{
+		m_StatusResult.clear();
+		m_DepotPaths.clear();
+		m_Opened.clear();
+
+		// No -T so that the state is the same as changeStatus gets from the server
+		PathListBuilder paths(assets, kPathWild | kPathSkipFolders);
+		std::string cmd = "fstat ";
+		cmd.reserve(cmd.length() + paths.GetLength());
+		paths.AppendTo(cmd);
+		return task.CommandRun(cmd, this);
+	}
+
+	// Results are only made of stat output
+	virtual void HandleError(Error* err)
+	{
+		P4Command::HandleError(err);
+	}
+
+	const VersionedAssetList& GetResult() const { return m_StatusResult; }
+	const std::vector<std::string>& GetDepotPaths() const { return m_DepotPaths; }
+	const std::vector<std::string>& GetOpenedAs() const { return m_Opened; }
+};
+
+P4OpenedIndex::P4OpenedIndex()
+	: m_Enabled(false), m_Built(false), m_Dirty(false), m_Validated(0), m_ChangesKnown(false), m_ChangesTime(0)
+{
+}
+
+void P4OpenedIndex::SetEnabled(bool enabled)
+{
+	m_Enabled = enabled;
+	Clear();
+}
+
+void P4OpenedIndex::Clear()
+{
+	m_Built = false;
+	m_Dirty = false;
+	m_Entries.clear();
+	m_DepotFiles.clear();
+	m_ChangesKnown = false;
+	m_Changes.clear();
+}
+
+void P4OpenedIndex::Open(const std::string& key)
+{
+	if (key == m_Key)
+		return;
+	Clear();
+	m_Key = key;
+}
+
+void P4OpenedIndex::BeginCommand(UnityCommand cmd)
+{
+	switch (cmd)
+	{
+	// The files are updated from the results of the commands, see Update()
+	case UCOM_Submit:
+	case UCOM_ChangeMove:
+	case UCOM_DeleteChanges:
+	case UCOM_RevertChanges:
+		m_ChangesKnown = false;
+		break;
+	default:
+		break;
+	}
+}
+
+bool P4OpenedIndex::GetFiles(P4Task& task, const ChangelistRevision& change, VersionedAssetList& files)
+{
+	files.clear();
+	if (!m_Enabled || m_Key.empty())
+		return false;
+
+	Microseconds now = GetMonotonicTime();
+	if (!m_Built || m_Dirty || now - m_Validated > VALIDATE_INTERVAL_US)
+	{
+		if (!Refresh(task))
+		{
+			Clear();
+			return false;
+		}
+		m_Built = true;
+		m_Dirty = false;
+		m_Validated = now;
+	}
+
+	std::string opened = (change == kDefaultListRevision ? std::string("default") : change) + " ";
+	for (EntryMap::const_iterator i = m_Entries.begin(); i != m_Entries.end(); ++i)
+	{
+		if (!StartsWith(i->second.opened, opened))
+			continue;
+
+		VersionedAsset asset = i->second.asset;
+		asset.RemoveState(kLocal);
+		asset.RemoveState(kReadOnly);
+		if (PathExists(asset.GetPath()))
+		{
+			asset.AddState(kLocal);
+			if (IsReadOnly(asset.GetPath()))
+				asset.AddState(kReadOnly);
+		}
+		files.push_back(asset);
+	}
+	return true;
+}
+
+// Ask the server which files are opened and state all of them again. Besides
+// files opened or reverted elsewhere this catches what changes while a file
+// stays opened, e.g. a resolve scheduled by a sync or a lock by another user.
+bool P4OpenedIndex::Refresh(P4Task& task)
+{
+	P4OpenedCommand opened;
+	if (!task.CommandRun("opened", &opened))
+		return false;
+
+	m_Entries.clear();
+	m_DepotFiles.clear();
+
+	VersionedAssetList files;
+	files.reserve(opened.m_Files.size());
+	for (std::map<std::string, std::string>::const_iterator o = opened.m_Files.begin(); o != opened.m_Files.end(); ++o)
+		files.push_back(VersionedAsset(WildcardsRemove(o->first)));
+	if (files.empty())
+		return true;
+
+	P4Command::Conn().Log().Info() << "Opened files index: stating " << files.size() << " opened files" << Endl;
+	P4OpenedStatCommand stat;
+	if (!stat.Run(task, files))
+		return false;
+
+	const VersionedAssetList& result = stat.GetResult();
+	const std::vector<std::string>& depotPaths = stat.GetDepotPaths();
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		if (!IsOpened(result[i]))
+			continue;
+		Entry& e = m_Entries[depotPaths[i]];
+		e.opened = stat.GetOpenedAs()[i];
+		e.asset = result[i];
+		m_DepotFiles[result[i].GetPath()] = depotPaths[i];
+	}
+	return true;
+}
+
+void P4OpenedIndex::Remove(const std::string& depotFile)
+{
+	EntryMap::iterator i = m_Entries.find(depotFile);
+	if (i == m_Entries.end())
+		return;
+	m_DepotFiles.erase(i->second.asset.GetPath());
+	m_Entries.erase(i);
+}
+
+bool P4OpenedIndex::GetChanges(Changes& changes) const
+{
+	if (!m_Enabled || m_Key.empty() || !m_ChangesKnown || GetMonotonicTime() - m_ChangesTime > VALIDATE_INTERVAL_US)
+		return false;
+	changes = m_Changes;
+	return true;
+}
+
+void P4OpenedIndex::SetChanges(const Changes& changes)
+{
+	if (!m_Enabled || m_Key.empty())
+		return;
+	m_Changes = changes;
+	m_ChangesKnown = true;
+	m_ChangesTime = GetMonotonicTime();
+}
+
+void P4OpenedIndex::Update(const VersionedAssetList& assets)
+{
+	Update(assets, std::vector<std::string>(), std::vector<std::string>());
+}
+
+void P4OpenedIndex::Update(const VersionedAssetList& assets, const std::vector<std::string>& depotPaths,
+						   const std::vector<std::string>& opened)
+{
+	if (!m_Built)
+		return;
+
+	for (size_t n = 0; n < assets.size(); ++n)
+	{
+		const VersionedAsset& asset = assets[n];
+		std::string depotFile = n < depotPaths.size() ? depotPaths[n] : std::string();
+		if (depotFile.empty())
+		{
+			std::map<std::string, std::string>::const_iterator d = m_DepotFiles.find(asset.GetPath());
+			if (d != m_DepotFiles.end())
+				depotFile = d->second;
+		}
+
+		if (!IsOpened(asset))
+		{
+			if (!depotFile.empty())
+				Remove(depotFile);
+			continue;
+		}
+
+		// A file opened in a change not told about is found by building again
+		std::string change = n < opened.size() ? opened[n] : std::string();
+		EntryMap::iterator e = depotFile.empty() ? m_Entries.end() : m_Entries.find(depotFile);
+		if (depotFile.empty() || (change.empty() && e == m_Entries.end()))
+		{
+			m_Dirty = true;
+			continue;
+		}
+
+		Entry& entry = e != m_Entries.end() ? e->second : m_Entries[depotFile];
+		if (!change.empty())
+			entry.opened = change;
+		entry.asset = asset;
+		m_DepotFiles[asset.GetPath()] = depotFile;
+
+		// As is the other half of a move that is not known as moved yet
+		if (asset.HasState(kMovedLocal))
+		{
+			EntryMap::const_iterator m = m_Entries.find(asset.GetMovedPath());
+			if (m == m_Entries.end() || m->second.opened.find(" move/") == std::string::npos)
+				m_Dirty = true;
+		}
+	}
+}
+
+void P4OpenedIndex::Invalidate()
+{
+	m_Dirty = true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <map>
+#include <string>
+#include "Changes.h"
+#include "Command.h"
+#include "Metrics.h"
+#include "VersionedAsset.h"
+
+class P4Task;
+
+// Files opened in the workspace by changelist and the pending changelists.
+// Unity asks for them every time it refreshes its lists and changeStatus would
+// otherwise make the server look at the whole client view each time.
+//
+// The index is built from 'opened' and one fstat of just the opened files,
+// which unlike 'fstat -W -e' does not make the server go through the client
+// view. The state Unity is sent after our own commands, status requests
+// included, updates the files in the index. It is built again now and then
+// to catch changes made outside of Unity, e.g. a lock taken by another user,
+// and when a result tells of a file opened in a change it does not know.
+class P4OpenedIndex
+{
+public:
+	P4OpenedIndex();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const { return m_Enabled; }
+
+	// Use the index of the workspace given by key. Drops what is kept for any
+	// other workspace.
+	void Open(const std::string& key);
+
+	// Tell the index about a Unity command starting
+	void BeginCommand(UnityCommand cmd);
+
+	// Files opened in a changelist. Returns false if the index could not be
+	// brought up to date and the server has to be asked.
+	bool GetFiles(P4Task& task, const ChangelistRevision& change, VersionedAssetList& files);
+
+	// Pending changelists of the workspace, without the default one. Returns
+	// false if they are not known.
+	bool GetChanges(Changes& changes) const;
+	void SetChanges(const Changes& changes);
+
+	// State of files after a command. Files opened in a change the results do
+	// not tell, and not yet in the index, make it be built again.
+	void Update(const VersionedAssetList& assets);
+	// Results of fstat with the change and action of each file
+	void Update(const VersionedAssetList& assets, const std::vector<std::string>& depotPaths,
+				const std::vector<std::string>& opened);
+
+	// For changes the results do not tell about
+	void Invalidate();
+
+	void Clear();
+
+private:
+	bool Refresh(P4Task& task);
+	void Remove(const std::string& depotFile);
+
+	struct Entry
+	{
+		std::string opened; // change and action
+		VersionedAsset asset;
+	};
+	typedef std::map<std::string, Entry> EntryMap; // by depot path
+
+	bool m_Enabled;
+	std::string m_Key;
+
+	bool m_Built;
+	bool m_Dirty;
+	Microseconds m_Validated;
+	EntryMap m_Entries;
+	std::map<std::string, std::string> m_DepotFiles; // by local path
+
+	bool m_ChangesKnown;
+	Microseconds m_ChangesTime;
+	Changes m_Changes;
+};
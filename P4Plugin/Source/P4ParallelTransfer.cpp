@@ -0,0 +1,186 @@
+#include "P4ParallelTransfer.h"
+#include "P4Info.h"
+#include "P4Task.h"
+#include "P4Utility.h"
+#include "strarray.h"
+#include <exception>
+#include <sstream>
+
+// Parallel sync came with 2014.1 and parallel submit with 2015.1
+const int SYNC_MIN_YEAR = 2014;
+const int SUBMIT_MIN_YEAR = 2015;
+
+// Keeps the output of a transfer thread away from Unity. Only errors are of
+// interest and are reported by the main thread once all are done.
+class P4TransferUser : public ClientUser
+{
+public:
+	P4TransferUser(std::string& errors) : m_Errors(errors) {}
+
+	virtual void HandleError(Error* err)
+	{
+		if (err == NULL || err->GetSeverity() < E_FAILED)
+			return;
+		StrBuf buf;
+		err->Fmt(&buf);
+		m_Errors += buf.Text();
+	}
+
+	virtual void Message(Error* err) { HandleError(err); }
+	virtual void OutputError(const char* errBuf) { m_Errors += errBuf; }
+	virtual void OutputInfo(char level, const char* data) {}
+	virtual void OutputText(const char* data, int length) {}
+	virtual void OutputBinary(const char* data, int length) {}
+	virtual void OutputStat(StrDict* varList) {}
+
+private:
+	std::string& m_Errors;
+};
+
+P4ParallelTransfer::P4ParallelTransfer(P4Task& task)
+	: m_Task(task), m_Enabled(false), m_Threads(0), m_Batch(0), m_MinSize(0)
+{
+}
+
+void P4ParallelTransfer::SetThreads(int threads)
+{
+	m_Threads = threads > 1 ? threads : 0;
+}
+
+void P4ParallelTransfer::SetBatch(int batch)
+{
+	m_Batch = batch > 0 ? batch : 0;
+}
+
+void P4ParallelTransfer::SetMinSize(int bytes)
+{
+	m_MinSize = bytes > 0 ? bytes : 0;
+}
+
+std::string P4ParallelTransfer::GetSyncOption(const P4Info& info) const
+{
+	if (!m_Enabled || m_Threads == 0 || !IsServerVersionAtLeast(info.serverVersion, SYNC_MIN_YEAR, 1))
+		return std::string();
+
+	std::stringstream ss;
+	ss << "--parallel=threads=" << m_Threads;
+	if (m_Batch)
+		ss << ",batch=" << m_Batch;
+	if (m_MinSize)
+		ss << ",minsize=" << m_MinSize;
+	return ss.str();
+}
+
+std::string P4ParallelTransfer::GetSubmitOption(const P4Info& info) const
+{
+	if (!m_Enabled || m_Threads == 0 || !IsServerVersionAtLeast(info.serverVersion, SUBMIT_MIN_YEAR, 1))
+		return std::string();
+
+	// Submit has no size threshold
+	std::stringstream ss;
+	ss << "--parallel=threads=" << m_Threads;
+	if (m_Batch)
+		ss << ",batch=" << m_Batch;
+	return ss.str();
+}
+
+int P4ParallelTransfer::Transfer(ClientApi* client, ClientUser* ui, const char* cmd, StrArray& args,
+								 StrDict& pVars, int threads, Error* e)
+{
+	Connection& conn = *m_Task.m_Connection;
+	if (threads > m_Threads)
+		threads = m_Threads;
+	if (threads < 1)
+		threads = 1;
+
+	std::vector<Worker*> workers;
+	for (int i = 0; i < threads; ++i)
+	{
+		Worker* w = new Worker();
+		w->transfer = this;
+		w->cmd = cmd;
+		w->args = &args;
+		w->vars = &pVars;
+		w->succeeded = false;
+		w->capture = NULL;
+		workers.push_back(w);
+	}
+
+	// The calling thread works too
+	for (size_t i = 1; i < workers.size(); ++i)
+	{
+		if (!workers[i]->thread.Start(WorkerMain, workers[i]))
+			workers[i]->errors = "Could not start transfer thread";
+	}
+	RunWorker(*workers[0]);
+
+	int failed = 0;
+	std::string errors;
+	for (std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); ++i)
+	{
+		if ((*i)->thread.IsStarted())
+			(*i)->thread.Join();
+		// Only metrics since the output of the threads was not kept
+		if ((*i)->capture != NULL)
+		{
+			conn.SendCaptured(*(*i)->capture);
+			delete (*i)->capture;
+		}
+		if (!(*i)->succeeded)
+		{
+			++failed;
+			errors += (*i)->errors;
+		}
+		delete *i;
+	}
+
+	if (failed)
+	{
+		conn.Log().Notice() << failed << " of " << threads << " transfer threads of " << cmd << " failed: " << errors << Endl;
+		e->Set(E_FAILED, "Parallel file transfer failed");
+	}
+	return failed ? 1 : 0;
+}
+
+void P4ParallelTransfer::WorkerMain(void* data)
+{
+	Worker* w = (Worker*)data;
+	w->transfer->RunWorker(*w);
+}
+
+void P4ParallelTransfer::RunWorker(Worker& w)
+{
+	Connection& conn = *m_Task.m_Connection;
+	conn.BeginCapture("");
+	try
+	{
+		// The server tells each thread which files it is to transfer
+		ClientApi client;
+		if (m_Task.InitPooledClient(client, w.vars))
+		{
+			std::vector<char*> argv;
+			for (int i = 0; i < w.args->Count(); ++i)
+				argv.push_back(w.args->Get(i)->Text());
+			client.SetArgv((int)argv.size(), argv.empty() ? NULL : &argv[0]);
+
+			P4TransferUser user(w.errors);
+			Metrics::Mark mark = conn.GetMetrics().BeginServerCommand();
+			client.Run(w.cmd, &user);
+			conn.GetMetrics().EndServerCommand(std::string(w.cmd) + " (transfer)", mark);
+
+			Error err;
+			client.Final(&err);
+			w.succeeded = w.errors.empty() && !err.Test();
+		}
+		else
+		{
+			w.errors += "Could not connect";
+		}
+	}
+	catch (std::exception& ex)
+	{
+		w.errors += ex.what();
+	}
+
+	w.capture = conn.EndCapture();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Thread.h"
+#include "clientapi.h"
+
+class P4Task;
+struct ConnectionCapture;
+struct P4Info;
+
+// Parallel file transfer for sync and submit. When the server agrees to it a
+// command run with the option from GetSyncOption() or GetSubmitOption() and
+// this set as its transfer hands the files over in batches to Transfer(),
+// which runs them on extra connections, one per thread.
+//
+// Only the settings are used when not enabled e.g. in test mode.
+class P4ParallelTransfer : public ClientTransfer
+{
+public:
+	P4ParallelTransfer(P4Task& task);
+
+	void SetEnabled(bool enabled) { m_Enabled = enabled; }
+
+	// Less than two threads disables parallel transfer
+	void SetThreads(int threads);
+	int GetThreads() const { return m_Threads; }
+
+	// Files per batch handed to a thread. 0 leaves it to the server.
+	void SetBatch(int batch);
+	int GetBatch() const { return m_Batch; }
+
+	// Files smaller than this are synced serially. 0 leaves it to the server.
+	void SetMinSize(int bytes);
+	int GetMinSize() const { return m_MinSize; }
+
+	// Option to add to the command or an empty string if parallel transfer is
+	// disabled or not supported by the server.
+	std::string GetSyncOption(const P4Info& info) const;
+	std::string GetSubmitOption(const P4Info& info) const;
+
+	virtual int Transfer(ClientApi* client, ClientUser* ui, const char* cmd, StrArray& args,
+						 StrDict& pVars, int threads, Error* e);
+
+private:
+	P4ParallelTransfer(const P4ParallelTransfer&);
+	P4ParallelTransfer& operator=(const P4ParallelTransfer&);
+
+	struct Worker
+	{
+		P4ParallelTransfer* transfer;
+		const char* cmd;
+		StrArray* args;
+		StrDict* vars;
+		bool succeeded;
+		std::string errors;
+		ConnectionCapture* capture;
+		Thread thread;
+	};
+
+	static void WorkerMain(void* data);
+	void RunWorker(Worker& w);
+
+	P4Task& m_Task;
+	bool m_Enabled;
+	int m_Threads;
+	int m_Batch;
+	int m_MinSize;
+};
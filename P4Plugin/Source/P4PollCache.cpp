@@ -0,0 +1,121 @@
+#include "P4PollCache.h"
+#include "Connection.h"
+
+// The user counts as busy this long after a command the user started
+const Microseconds ACTIVE_WINDOW_US = (Microseconds)30 * 1000 * 1000;
+// Responses older than this are never sent again
+const Microseconds MAX_AGE_US = (Microseconds)60 * 1000 * 1000;
+
+P4PollCache::P4PollCache()
+	: m_Valid(false), m_Time(0), m_LastUserCommand(0)
+{
+}
+
+bool P4PollCache::IsKept(UnityCommand cmd)
+{
+	// The expensive poll. Changes and changeStatus show the user's own pending
+	// changelists which must be current right after a checkout.
+	return cmd == UCOM_Incoming;
+}
+
+bool P4PollCache::IsUserStarted(UnityCommand cmd)
+{
+	// Unity asks for the status of assets by itself all the time, e.g. when
+	// the project window repaints, and custom commands poll background submits
+	switch (cmd)
+	{
+	case UCOM_Status:
+	case UCOM_CustomCommand:
+		return false;
+	default:
+		return UnityCommandToPriority(cmd) == UCP_Interactive;
+	}
+}
+
+bool P4PollCache::Invalidates(UnityCommand cmd)
+{
+	switch (cmd)
+	{
+	case UCOM_GetLatest:
+	case UCOM_Resolve:
+	case UCOM_Submit:
+	case UCOM_Config:
+	case UCOM_Login:
+	case UCOM_Login2:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Errors and commands such as going offline are not sent again
+bool P4PollCache::HasErrors(const std::string& response)
+{
+	std::string::size_type pos = 0;
+	while (pos < response.size())
+	{
+		char c = response[pos];
+		if (c == 'e' || c == 'c')
+			return true;
+		pos = response.find('\n', pos);
+		if (pos == std::string::npos)
+			break;
+		++pos;
+	}
+	return false;
+}
+
+bool P4PollCache::Answer(UnityCommand cmd, const CommandArgs& args, Connection& conn)
+{
+	if (!m_Valid || !IsKept(cmd) || args != m_Args)
+		return false;
+
+	Microseconds now = GetMonotonicTime();
+	if (now - m_Time > MAX_AGE_US || m_LastUserCommand == 0 || now - m_LastUserCommand > ACTIVE_WINDOW_US)
+		return false;
+
+	conn.Log().Info() << "Deferring " << args[0] << " while the user is busy. Sending the response from "
+					  << (now - m_Time) / 1000000 << " s ago." << Endl;
+	conn.Resend(m_Response);
+	conn.EndResponse();
+	return true;
+}
+
+std::string* P4PollCache::BeginCommand(UnityCommand cmd, const CommandArgs& args)
+{
+	if (Invalidates(cmd))
+		Clear();
+
+	if (!IsKept(cmd))
+		return NULL;
+
+	m_PendingArgs = args;
+	m_Pending.clear();
+	return &m_Pending;
+}
+
+void P4PollCache::EndCommand(UnityCommand cmd, bool succeeded)
+{
+	if (IsUserStarted(cmd))
+		m_LastUserCommand = GetMonotonicTime();
+
+	if (!IsKept(cmd))
+		return;
+
+	if (succeeded && !HasErrors(m_Pending))
+	{
+		m_Args.swap(m_PendingArgs);
+		m_Response.swap(m_Pending);
+		m_Time = GetMonotonicTime();
+		m_Valid = true;
+	}
+	m_PendingArgs.clear();
+	m_Pending.clear();
+}
+
+void P4PollCache::Clear()
+{
+	m_Valid = false;
+	m_Args.clear();
+	m_Response.clear();
+}
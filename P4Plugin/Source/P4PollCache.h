@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include "Command.h"
+#include "Metrics.h"
+
+class Connection;
+
+// Unity talks to the plugin one command at a time, so a background poll (see
+// UnityCommandToPriority()) that goes to the server delays whatever the user
+// does next. An incoming refresh runs fstat on the whole workspace which on a
+// large project keeps a checkout waiting for many seconds.
+//
+// The last response to such a poll is kept and sent again while the user is
+// busy with commands of their own, deferring the real poll until the user has
+// been idle for a while or the response is a minute old. Commands that change what
+// the poll would return drop the kept response.
+class P4PollCache
+{
+public:
+	P4PollCache();
+
+	// Answer a poll with the kept response if it should be deferred. Returns
+	// false if the command has to run.
+	bool Answer(UnityCommand cmd, const CommandArgs& args, Connection& conn);
+
+	// Where to record the response of a command about to run or NULL if it is
+	// not kept. See Connection::RecordResponse().
+	std::string* BeginCommand(UnityCommand cmd, const CommandArgs& args);
+
+	// Keep the recorded response if the command went well
+	void EndCommand(UnityCommand cmd, bool succeeded);
+
+	void Clear();
+
+private:
+	static bool IsKept(UnityCommand cmd);
+	static bool IsUserStarted(UnityCommand cmd);
+	static bool Invalidates(UnityCommand cmd);
+	static bool HasErrors(const std::string& response);
+
+	bool m_Valid;
+	CommandArgs m_Args;
+	std::string m_Response;
+	Microseconds m_Time;
+
+	CommandArgs m_PendingArgs;
+	std::string m_Pending;
+
+	Microseconds m_LastUserCommand;
+};
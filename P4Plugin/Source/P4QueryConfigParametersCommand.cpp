@@ -11,6 +11,12 @@ public:
 		Conn().DataLine("text password");
 		Conn().DataLine("hostAndPort server localhost 1666");
 		Conn().DataLine("text workspace");
+		// Parallel sync and submit, see P4ParallelTransfer
+		Conn().DataLine("text parallelThreads 0");
+		Conn().DataLine("text parallelBatch 0");
+		Conn().DataLine("text parallelMinSize 0");
+		// Submit in the background, see P4SubmitJobs
+		Conn().DataLine("text asyncSubmit off");
 		Conn().DataLine("");
 		
 		return true;
@@ -1,6 +1,50 @@
 #include "Changes.h"
 #include "P4Command.h"
+#include "P4SubmitJobs.h"
 #include "P4Task.h"
+#include "P4Utility.h"
+
+// Reverts the files of one changelist as part of a batch, see P4Task::CommandRunBatch()
+class P4RevertChangeCommand : public P4Command
+{
+public:
+	P4RevertChangeCommand(const std::string& command) : m_Command(command) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+	virtual std::string BeginRun(P4Task& task) { return m_Command; }
+
+	// Each reverted file is told about so that only those need a status afterwards
+	virtual bool IsTagged() const { return true; }
+
+	virtual void OutputStat( StrDict *varList )
+	{
+		StrPtr* clientFile = varList->GetVar("clientFile");
+		if (clientFile == NULL)
+			return;
+
+		std::string path(clientFile->Text());
+		path = StartsWith(path, "//") ? WildcardsRemove(path) : Replace(path, "\\", "/");
+		Conn().VerboseLine(path);
+		m_Reverted.push_back(VersionedAsset(path));
+	}
+
+	virtual void HandleError( Error *err )
+	{
+		if ( err == 0 )
+			return;
+
+		StrBuf buf;
+		err->Fmt(&buf);
+		if (EndsWith(TrimEnd(std::string(buf.Text()), '\n'), " - file(s) not opened on this client."))
+			return; // nothing to revert is fine
+
+		P4Command::HandleError(err);
+	}
+
+	VersionedAssetList m_Reverted;
+
+private:
+	std::string m_Command;
+};
 
 class P4RevertChangesCommand : public P4Command
 {
@@ -10,7 +54,6 @@ public:
 	{
 		ClearStatus();
 		Conn().Log().Info() << args[0] << "::Run()" << Endl;
-		std::string errorMessage;
 		
 		const std::string cmd = args.size() > 1 && args[1] == "unchangedOnly" ? 
 		"revert -a -c " :
@@ -26,23 +69,51 @@ public:
 			return true;
 		}
 		
-		std::string cl;
-		for (ChangelistRevisions::const_iterator i = changes.begin(); i != changes.end(); ++i)
+		// The changelists are independent so one failing does not stop the others.
+		// Those being submitted in the background are left alone.
+		std::vector<P4Command*> reverts;
+		for (ChangelistRevisions::iterator i = changes.begin(); i != changes.end(); )
 		{
+			if (task.GetSubmitJobs().IsSubmitting(*i))
+			{
+				Conn().WarnLine("Change " + *i + " is being submitted and was not reverted", MARemote);
+				i = changes.erase(i);
+				continue;
+			}
 			std::string rev = *i == kDefaultListRevision ? std::string("default") : *i;
-			std::string cmdr = cmd + " \"" + rev + "\"";
+			reverts.push_back(new P4RevertChangeCommand(cmd + " \"" + rev + "\" //..."));
+			++i;
+		}
+
+		std::vector<bool> results;
+		task.CommandRunBatch(reverts, results);
 
-			if (!task.CommandRun(cmdr, this))
-				break;
+		VersionedAssetList reverted;
+		for (size_t i = 0; i < reverts.size(); ++i)
+		{
+			P4RevertChangeCommand* revert = (P4RevertChangeCommand*)reverts[i];
+			const VCSStatus& status = revert->GetStatus();
+			GetStatus().insert(status.begin(), status.end());
+			if (!results[i] && status.empty())
+				Conn().WarnLine("Revert of changelist " + changes[i] + " was not done");
+			reverted.insert(reverted.end(), revert->m_Reverted.begin(), revert->m_Reverted.end());
+			delete reverts[i];
 		}
 		
 		// The OutputState and other callbacks will now output to stdout.
 		// We just wrap up the communication here.
 		Conn() << GetStatus();
 
-		// @TODO: send changed assets
-		VersionedAssetList dummy;
-		Conn() << dummy;
+		// One status for the files of all the changelists
+		if (reverted.empty() || !P4Task::IsOnline())
+		{
+			VersionedAssetList none;
+			Conn() << none;
+		}
+		else
+		{
+			RunAndSendStatus(task, reverted);
+		}
 		
 		Conn().EndResponse();
 		
@@ -1,6 +1,7 @@
 #include "P4Command.h"
 #include "P4Utility.h"
 #include "FileSystem.h"
+#include "P4OpenedIndex.h"
 
 class P4RevertCommand : public P4Command
 {
@@ -19,9 +20,12 @@ public:
 	
 		VersionedAssetList assetList;
 		Conn() >> assetList;
+		if (RejectSubmitting(task, assetList))
+			return true;
+
 		std::string paths = ResolvePaths(assetList, kPathWild | kPathRecursive);
 	
-		Conn().Log().Debug() << "Paths resolved are: " << paths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths resolved are: " << paths << Endl;
 	
 		if (paths.empty())
 		{
@@ -59,6 +63,7 @@ public:
 			}
 		}
 
+		task.GetOpenedIndex().Update(m_Result);
 		Conn() << m_Result;
 		m_Result.clear();
 		Conn() << GetStatus();
@@ -134,7 +139,7 @@ public:
 
 			if (EndsWith(value, TrimEnd(" - file(s) not opened on this client.\n")))
 			{
-				Conn().Log().Debug() << value << Endl;
+				DEBUG_LOG(Conn().Log()) << value << Endl;
 				Conn().VerboseLine(value);
 				return; // ignore
 			}
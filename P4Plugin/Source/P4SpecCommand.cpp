@@ -13,6 +13,7 @@ public:
 	{
 		ClearStatus();
 		m_Root.clear();
+		m_Update.clear();
 
 		Conn().Log().Info() << args[0] << "::Run()" << Endl;
 		m_IsTestMode = args.size() > 2 && (args[2] == "-test");
@@ -60,6 +61,7 @@ public:
 		}
 		if (!m_Root.empty())
 			task.SetP4Root(m_Root);
+		task.SetP4ClientUpdate(m_Update);
 		Conn().Log().Info() << "Root set to " << m_Root << Endl;
 		return true;
 	}
@@ -74,6 +76,12 @@ public:
 		std::string line;
 		while ( getline(ss, line) )
 		{
+			// Last time the spec was changed. Comes before the root.
+			if (StartsWith(line, "Update:"))
+			{
+				m_Update = Trim(Trim(line.substr(7), '\t'));
+				continue;
+			}
 
 			if (line.length() <= minlen || line.substr(0,minlen) != "Root:")
 				continue;
@@ -92,6 +100,7 @@ public:
 	}
 private:
 	std::string m_Root;
+	std::string m_Update;
 	bool m_IsTestMode;
 
 } cSpec("spec");
@@ -4,10 +4,27 @@
 #include "P4Utility.h"
 
 P4StatusBaseCommand::P4StatusBaseCommand(const char* name, bool streamResultToConnection) 
-	: P4Command(name), m_StreamResultToConnection(streamResultToConnection)
+	: P4Command(name), m_StreamResultToConnection(streamResultToConnection), m_KeepStreamedResult(false)
 {
 }
 
+P4StatusBaseCommand::P4StatusBaseCommand()
+	: m_StreamResultToConnection(false), m_KeepStreamedResult(false)
+{
+}
+
+void P4StatusBaseCommand::AddResult(const VersionedAsset& asset, const std::string& depotPath, const std::string& opened)
+{
+	if (m_StreamResultToConnection)
+		Conn() << asset;
+	if (!m_StreamResultToConnection || m_KeepStreamedResult)
+	{
+		m_StatusResult.push_back(asset);
+		m_DepotPaths.push_back(depotPath);
+		m_Opened.push_back(opened);
+	}
+}
+
 const std::string invalidPath = "//...";
 const std::string notFound = " - no such file(s).";
 const std::string notInClientView = " - file(s) not in client view.";
@@ -27,6 +44,7 @@ void P4StatusBaseCommand::OutputStat( StrDict *varList )
 	std::string headRev;
 	std::string haveRev;
 	std::string depotFile;
+	std::string change;
 	
 	// Dump out the variables, using the GetVar( x ) interface.
 	// Don't display the function, which is only relevant to rpc.
@@ -88,6 +106,10 @@ void P4StatusBaseCommand::OutputStat( StrDict *varList )
 		{
 			current.AddState(kConflicted);
 		} 
+		else if (key == "change")
+		{
+			change = value;
+		}
 		else if (key == "headAction")
 		{
 			headAction = value;
@@ -122,10 +144,8 @@ void P4StatusBaseCommand::OutputStat( StrDict *varList )
 
 	Conn().VerboseLine(current.GetPath());
 	
-	if (m_StreamResultToConnection)
-		Conn() << current;
-	else
-		m_StatusResult.push_back(current);
+	// Only opened files have a change, see P4OpenedIndex
+	AddResult(current, depotFile, change.empty() ? std::string() : change + " " + action);
 }
 
 void P4StatusBaseCommand::HandleError( Error *err )
@@ -161,10 +181,7 @@ void P4StatusBaseCommand::HandleError( Error *err )
 					asset.AddState(kReadOnly);
 			}
 
-			if (m_StreamResultToConnection)
-				Conn() << asset;
-			else
-				m_StatusResult.push_back(asset);
+			AddResult(asset, std::string());
 			Conn().VerboseLine(value);
 			return; // just ignore errors for unknown files and return them anyway
 		} 
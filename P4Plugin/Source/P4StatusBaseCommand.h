@@ -13,6 +13,15 @@ public:
 	virtual void HandleError( Error *err );
 	bool AddUnknown(VersionedAsset& current, const std::string& value);	
 protected:
+	// For extra instances, see P4Command::P4Command()
+	P4StatusBaseCommand();
+
+	// Stream to Unity and/or keep in m_StatusResult
+	void AddResult(const VersionedAsset& asset, const std::string& depotPath, const std::string& opened = std::string());
+
 	bool m_StreamResultToConnection;
+	bool m_KeepStreamedResult;
 	VersionedAssetList m_StatusResult;
+	std::vector<std::string> m_DepotPaths; // of m_StatusResult, empty if not in the depot
+	std::vector<std::string> m_Opened; // change and action of m_StatusResult, empty if not told
 };
@@ -0,0 +1,82 @@
+#include "P4StatusCache.h"
+#include "FileSystem.h"
+
+// Requests this close together are taken to be about the same state
+const Microseconds COALESCE_WINDOW_US = (Microseconds)2 * 1000 * 1000;
+// Bound the memory used when a large recursive status is kept
+const size_t MAX_ENTRIES = 100000;
+
+P4StatusCache::P4StatusCache()
+	: m_Enabled(false), m_InStatus(false)
+{
+}
+
+void P4StatusCache::SetEnabled(bool enabled)
+{
+	m_Enabled = enabled;
+	Clear();
+}
+
+void P4StatusCache::BeginCommand(UnityCommand cmd)
+{
+	m_InStatus = cmd == UCOM_Status;
+	if (!m_InStatus && UnityCommandToPriority(cmd) != UCP_Background)
+		Clear();
+}
+
+void P4StatusCache::Take(VersionedAssetList& assets, VersionedAssetList& found)
+{
+	found.clear();
+	if (!m_Enabled || m_Entries.empty())
+		return;
+
+	Microseconds now = GetMonotonicTime();
+	size_t remaining = 0;
+	for (size_t i = 0; i < assets.size(); ++i)
+	{
+		EntryMap::const_iterator e = m_Entries.find(assets[i].GetPath());
+		if (e == m_Entries.end() || now - e->second.time > COALESCE_WINDOW_US)
+		{
+			if (remaining != i)
+				assets[remaining] = assets[i];
+			++remaining;
+			continue;
+		}
+
+		VersionedAsset asset = e->second.asset;
+		asset.RemoveState(kLocal);
+		asset.RemoveState(kReadOnly);
+		if (PathExists(asset.GetPath()))
+		{
+			asset.AddState(kLocal);
+			if (IsReadOnly(asset.GetPath()))
+				asset.AddState(kReadOnly);
+		}
+		found.push_back(asset);
+	}
+	assets.resize(remaining);
+}
+
+void P4StatusCache::Store(const VersionedAssetList& results)
+{
+	if (!m_Enabled || !m_InStatus)
+		return;
+
+	if (m_Entries.size() + results.size() > MAX_ENTRIES)
+		Clear();
+	if (results.size() > MAX_ENTRIES)
+		return;
+
+	Microseconds now = GetMonotonicTime();
+	for (VersionedAssetList::const_iterator i = results.begin(); i != results.end(); ++i)
+	{
+		Entry& e = m_Entries[i->GetPath()];
+		e.asset = *i;
+		e.time = now;
+	}
+}
+
+void P4StatusCache::Clear()
+{
+	m_Entries.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <map>
+#include <string>
+#include "Command.h"
+#include "Metrics.h"
+#include "VersionedAsset.h"
+
+// The editor sends several status requests in a row for overlapping assets,
+// e.g. for a selection change and the inspector refresh that follows. The
+// results of a status request are kept for a moment so that the next one only
+// asks the server about assets it has not just been told about. Any command
+// other than status or a background poll may change the state and drops what
+// is kept.
+class P4StatusCache
+{
+public:
+	P4StatusCache();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const { return m_Enabled; }
+
+	// Tell the cache about a Unity command starting
+	void BeginCommand(UnityCommand cmd);
+
+	// Move the assets stated a moment ago from assets to found, with their
+	// state. Local file state is read again.
+	void Take(VersionedAssetList& assets, VersionedAssetList& found);
+
+	// Keep the results of the status request being handled
+	void Store(const VersionedAssetList& results);
+
+	void Clear();
+
+private:
+	struct Entry
+	{
+		VersionedAsset asset;
+		Microseconds time;
+	};
+	typedef std::map<std::string, Entry> EntryMap;
+
+	bool m_Enabled;
+	bool m_InStatus;
+	EntryMap m_Entries;
+};
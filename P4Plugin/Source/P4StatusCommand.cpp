@@ -1,5 +1,9 @@
 #include "P4StatusCommand.h"
 #include "P4Utility.h"
+#include "P4OpenedIndex.h"
+#include "P4StatusCache.h"
+#include "P4SubmitJobs.h"
+#include "P4Task.h"
 
 P4StatusCommand::P4StatusCommand(const char* name) : P4StatusBaseCommand(name) {}
 
@@ -10,6 +14,10 @@ bool P4StatusCommand::Run(P4Task& task, const CommandArgs& args)
 			
 	VersionedAssetList assetList;
 	Conn() >> assetList;
+
+	// Unity only knows the files of a background submit as they were when it
+	// started, so their state goes along once the submit is done
+	task.GetSubmitJobs().TakeSubmitted(assetList);
 	
 	RunAndSend(task, assetList, recursive);
 
@@ -42,13 +50,31 @@ void P4StatusCommand::PostStatus()
 void P4StatusCommand::RunAndSend(P4Task& task, const VersionedAssetList& assetList, bool recursive)
 {
 	m_StreamResultToConnection = true;
-	std::string paths = ResolvePaths(assetList, kPathWild | kPathSkipFolders | (recursive ? kPathRecursive : kNone) );
+
+	VersionedAssetList assets(assetList);
+	RemoveOverlappingPaths(assets, recursive);
+
+	// Assets stated by the status request just before are not asked about again
+	P4StatusCache& cache = task.GetStatusCache();
+	VersionedAssetList cached;
+	if (!recursive && P4Task::IsOnline())
+		cache.Take(assets, cached);
+
+	PathListBuilder paths(assets, kPathWild | kPathSkipFolders | (recursive ? kPathRecursive : kNone) );
 	
-	Conn().Log().Debug() << "Paths to stat are: " << paths << Endl;
+	DEBUG_LOG(Conn().Log()) << "Paths to stat are: " << paths << Endl;
 	
 	Conn().BeginList();
 
-	if (paths.empty())
+	if (!cached.empty())
+	{
+		Conn().Log().Info() << "Status of " << cached.size() << " of " << (cached.size() + assets.size())
+							<< " assets known from the previous request" << Endl;
+		for (VersionedAssetList::const_iterator i = cached.begin(); i != cached.end(); ++i)
+			Conn() << *i;
+	}
+
+	if (paths.IsEmpty())
 	{
 		Conn().EndList();
 		// Conn().ErrorLine("No paths to stat", MASystem);
@@ -58,11 +84,24 @@ void P4StatusCommand::RunAndSend(P4Task& task, const VersionedAssetList& assetLi
 	// Server >=2008: string cmd = "fstat -T \"movedFile,depotFile,clientFile,action,ourLock,unresolved,headAction,otherOpen,otherLock,headRev,haveRev\" ";
 	// Compatibility with old perforce servers (<2008). -T is not supported, so just retrieve all the information for the requested files
 	std::string cmd = "fstat ";
-	cmd += " " + paths;
+	cmd.reserve(cmd.length() + 1 + paths.GetLength());
+	cmd += " ";
+	paths.AppendTo(cmd);
 
 	// We're sending along an asset list with an unknown size.
 	PreStatus();
-	task.CommandRun(cmd, this);
+	m_StatusResult.clear();
+	m_DepotPaths.clear();
+	m_Opened.clear();
+	P4OpenedIndex& index = task.GetOpenedIndex();
+	m_KeepStreamedResult = cache.IsEnabled() || index.IsEnabled();
+	if (task.CommandRun(cmd, this))
+		cache.Store(m_StatusResult);
+	index.Update(m_StatusResult, m_DepotPaths, m_Opened);
+	m_KeepStreamedResult = false;
+	m_StatusResult.clear();
+	m_DepotPaths.clear();
+	m_Opened.clear();
 
 	// The OutputState and other callbacks will now output to stdout.
 	// We just wrap up the communication here.
@@ -71,23 +110,57 @@ void P4StatusCommand::RunAndSend(P4Task& task, const VersionedAssetList& assetLi
 	PostStatus();
 }
 
+static const char* kStatusFields = "movedFile,depotFile,clientFile,action,ourLock,unresolved,headAction,otherOpen,otherLock,headRev,haveRev";
+
 void P4StatusCommand::Run(P4Task& task, const VersionedAssetList& assetList, bool recursive, VersionedAssetList& result)
+{
+	RunTagged(task, assetList, recursive, kStatusFields, result);
+	m_DepotPaths.clear();
+	m_Opened.clear();
+}
+
+void P4StatusCommand::RunWithDepotPaths(P4Task& task, const VersionedAssetList& assetList, VersionedAssetList& result,
+										std::vector<std::string>& depotPaths)
+{
+	RunTagged(task, assetList, false, std::string(kStatusFields) + ",headType", result);
+	depotPaths.swap(m_DepotPaths);
+	m_DepotPaths.clear();
+	m_Opened.clear();
+}
+
+static const char* kOpenStateFields = "movedFile,depotFile,clientFile,action,ourLock,unresolved,otherOpen,otherLock,otherAction,headType";
+
+void P4StatusCommand::RunOpenState(P4Task& task, const VersionedAssetList& assetList, VersionedAssetList& result)
+{
+	RunTagged(task, assetList, false, kOpenStateFields, result);
+	m_DepotPaths.clear();
+	m_Opened.clear();
+}
+
+void P4StatusCommand::RunTagged(P4Task& task, const VersionedAssetList& assetList, bool recursive, const std::string& fields,
+								VersionedAssetList& result)
 {
 	m_StreamResultToConnection = false;
 	m_StatusResult.clear();
-	std::string paths = ResolvePaths(assetList, kPathWild | kPathSkipFolders | (recursive ? kPathRecursive : kNone) );
+	m_DepotPaths.clear();
+	m_Opened.clear();
+	VersionedAssetList assets(assetList);
+	RemoveOverlappingPaths(assets, recursive);
+	PathListBuilder paths(assets, kPathWild | kPathSkipFolders | (recursive ? kPathRecursive : kNone) );
 	
 	result.clear();
-	Conn().Log().Info() << "Paths to stat are: " << paths << Endl;
+	INFO_LOG(Conn().Log()) << "Paths to stat are: " << paths << Endl;
 	
-	if (paths.empty())
+	if (paths.IsEmpty())
 	{
 		// Conn().ErrorLine("No paths to stat", MASystem);
 		return;
 	}
 	
-	std::string cmd = "fstat -T \"movedFile,depotFile,clientFile,action,ourLock,unresolved,headAction,otherOpen,otherLock,headRev,haveRev\" ";
-	cmd += " " + paths;
+	std::string cmd = "fstat -T \"" + fields + "\" ";
+	cmd.reserve(cmd.length() + 1 + paths.GetLength());
+	cmd += " ";
+	paths.AppendTo(cmd);
 
 	// We're sending along an asset list with an unknown size.
 	PreStatus();
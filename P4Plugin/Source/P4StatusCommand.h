@@ -8,7 +8,17 @@ public:
 	virtual bool Run(P4Task& task, const CommandArgs& args);
 	void RunAndSend(P4Task& task, const VersionedAssetList& assets, bool recursive);
 	void Run(P4Task& task, const VersionedAssetList& assetList, bool recursive, VersionedAssetList& result);
+
+	// Status with the depot path of each result, empty if not in the depot. Also
+	// tells which files are exclusive checkout.
+	void RunWithDepotPaths(P4Task& task, const VersionedAssetList& assetList, VersionedAssetList& result,
+						   std::vector<std::string>& depotPaths);
+	// Only how the files are opened here and by others and if they are
+	// exclusive checkout. Revisions are left out.
+	void RunOpenState(P4Task& task, const VersionedAssetList& assetList, VersionedAssetList& result);
 private:
+	void RunTagged(P4Task& task, const VersionedAssetList& assetList, bool recursive, const std::string& fields,
+				   VersionedAssetList& result);
 	void PreStatus();
 	void PostStatus();
 	bool m_WasOnline;
@@ -9,11 +9,21 @@ class P4StreamsCommand : public P4Command
 public:
 	P4StreamsCommand(const char* name) : P4Command(name) { }
 	virtual bool Run(P4Task& task, const CommandArgs& args)
+	{
+		std::string cmd = BeginRun(task);
+		return EndRun(task, task.CommandRun(cmd, this));
+	}
+
+	virtual std::string BeginRun(P4Task& task)
 	{
 		ClearStatus();
 		m_Streams.clear();
+		return "streams";
+	}
 
-		if (!task.CommandRun("streams", this))
+	virtual bool EndRun(P4Task& task, bool ok)
+	{
+		if (!ok)
 		{
 			std::string errorMessage = GetStatusMessage();			
 			Conn().Log().Fatal() << errorMessage << Endl;
@@ -63,7 +73,7 @@ public:
 
     if (value.find("No such stream.") != std::string::npos)
     {
-      Conn().Log().Debug() << value << Endl;
+      DEBUG_LOG(Conn().Log()) << value << Endl;
       return;      
     }
 
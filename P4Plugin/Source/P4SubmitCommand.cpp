@@ -1,7 +1,15 @@
 #include "Changes.h"
+#include "FileSystem.h"
+#include "P4OpenedIndex.h"
 #include "P4FileSetBaseCommand.h"
+#include "P4ParallelTransfer.h"
+#include "P4StatusCommand.h"
+#include "P4SubmitJobs.h"
 #include "P4Task.h"
 #include "P4Utility.h"
+#include "ProgressReporter.h"
+#include <algorithm>
+#include <map>
 #include <sstream>
 #include <time.h>
 
@@ -35,14 +43,17 @@ class P4SubmitCommand : public P4Command
 private:
 	std::string m_Spec;
 public:
-	P4SubmitCommand(const char* name) : P4Command(name) {}
+	P4SubmitCommand(const char* name) : P4Command(name), m_Progress(NULL), m_Submitted(false) {}
 	virtual bool Run(P4Task& task, const CommandArgs& args)
 	{
-		m_StartTickTime = time(0);
 		m_ProjectPath = task.GetProjectPath();
 
 		ClearStatus();
 		m_Spec.clear();
+		m_Change.clear();
+		m_FileSizes.clear();
+		m_SubmittedFiles.clear();
+		m_ReopenedFiles.clear();
 		
 		Conn().Log().Info() << args[0] << "::Run()" << Endl;
 		
@@ -54,23 +65,62 @@ public:
 		VersionedAssetList assetList;
 		Conn() >> assetList;
 		bool hasFiles = !assetList.empty();
+		if (RejectSubmitting(task, assetList))
+			return true;
+
+		// One tagged status pass gives the client and depot paths of the files,
+		// their moved counterparts and the state to derive the one after submit from
+		std::vector<std::string> depotPaths;
+		GetStatusWithDepotPaths(task, assetList, depotPaths);
+		std::vector<std::string> assetDepotPaths(depotPaths);
 
 		// Handle the case where a user forgot to provide moved file counterpart e.g. 
 		// only listed the destination file and not the source or visa versa. (special case)
-		AddMovedAssets(task, assetList);
+		VersionedAssetList counterparts;
+		AddMovedAssets(assetList, depotPaths, counterparts);
 		
-		// Run a view mapping job to get the right depot relative paths for the spec file
-		std::string localPaths = ResolvePaths(assetList, kPathWild | kPathSkipFolders);
-		Conn().Log().Debug() << "Paths resolved are: " << localPaths << Endl;
+		DEBUG_LOG(Conn().Log()) << "Paths resolved are: " << PathListBuilder(assetList, kPathWild | kPathSkipFolders) << Endl;
 		
-		const std::vector<Mapping>& mappings = GetMappings(task, assetList);
+		// Files not in the depot need a view mapping job to get the depot relative
+		// paths for the spec file
+		if (std::find(depotPaths.begin(), depotPaths.end(), std::string()) != depotPaths.end())
+		{
+			VersionedAssetList toMap(assetList);
+			toMap.insert(toMap.end(), counterparts.begin(), counterparts.end());
+			const std::vector<Mapping>& mappings = GetMappings(task, toMap);
+
+			if (mappings.empty() && !toMap.empty())
+			{
+				// Abort since there was an error mapping files to depot path
+				RunAndSendStatus(task, toMap);
+				Conn().EndResponse();
+				return true;
+			}
 
-		if (mappings.empty() && !assetList.empty())
+			depotPaths.clear();
+			std::map<std::string, std::string> depotPathOf;
+			for (std::vector<Mapping>::const_iterator i = mappings.begin(); i != mappings.end(); ++i)
+			{
+				depotPaths.push_back(i->depotPath);
+				depotPathOf[i->clientPath] = i->depotPath;
+				AddFileSize(i->depotPath, i->clientPath);
+			}
+			for (size_t i = 0; i < assetList.size() && i < assetDepotPaths.size(); ++i)
+			{
+				std::map<std::string, std::string>::const_iterator m = depotPathOf.find(assetList[i].GetPath());
+				if (assetDepotPaths[i].empty() && m != depotPathOf.end())
+					assetDepotPaths[i] = m->second;
+			}
+		}
+		else
 		{
-			// Abort since there was an error mapping files to depot path
-			RunAndSendStatus(task, assetList);
-			Conn().EndResponse();
-			return true;
+			for (size_t i = 0; i < assetList.size() && i < depotPaths.size(); ++i)
+				AddFileSize(depotPaths[i], assetList[i].IsFolder() ? std::string() : assetList[i].GetPath());
+			for (VersionedAssetList::const_iterator i = counterparts.begin(); i != counterparts.end(); ++i)
+			{
+				depotPaths.push_back(i->GetPath());
+				AddFileSize(i->GetPath(), std::string());
+			}
 		}
 				
 		// Submit the changelist
@@ -88,21 +138,57 @@ public:
 		if (hasFiles)
 		{
 			std::string paths;			
-			for (std::vector<Mapping>::const_iterator i = mappings.begin(); i != mappings.end(); ++i) 
+			for (std::vector<std::string>::const_iterator i = depotPaths.begin(); i != depotPaths.end(); ++i) 
 			{
-				if (i != mappings.begin())
+				if (i != depotPaths.begin())
 					paths += "\n";
-				paths += i->depotPath;
+				paths += *i;
 			}
 			writer.WriteSection ("Files", paths);
 		}
 		
 		m_Spec = writer.GetText();
+
+		// Only the changelist is made while Unity waits
+		if (!saveOnly && hasFiles && task.GetSubmitJobs().IsEnabled())
+		{
+			VersionedAssetList all(assetList);
+			all.insert(all.end(), counterparts.begin(), counterparts.end());
+			if (StartBackgroundSubmit(task, all))
+			{
+				m_Spec.clear();
+				return true;
+			}
+		}
 		
-		// Submit or update the change list
-		const std::string cmd = saveOnly ? "change -i" : "submit -i";
+		// Submit or update the change list. Files are transferred on several
+		// connections when the server allows it.
+		std::string cmd = saveOnly ? "change -i" : "submit -i";
+		if (!m_Change.empty())
+			cmd = "submit -c " + m_Change; // made but could not be submitted in the background
+		std::string parallel = saveOnly ? std::string() : task.GetParallelTransfer().GetSubmitOption(task.GetP4Info());
+		if (!parallel.empty())
+		{
+			cmd = m_Change.empty() ? "submit " + parallel + " -i" : "submit " + parallel + " -c " + m_Change;
+			SetTransfer(&task.GetParallelTransfer());
+		}
 
+		// The server lists each file as it is submitted
+		unsigned long long totalBytes = 0;
+		for (std::map<std::string, unsigned long long>::const_iterator i = m_FileSizes.begin(); i != m_FileSizes.end(); ++i)
+			totalBytes += i->second;
+		ProgressReporter progress(Conn());
+		progress.Begin((unsigned int)m_FileSizes.size(), totalBytes);
+
+		m_Submitted = false;
+		m_Progress = &progress;
+		Microseconds start = GetMonotonicTime();
 		task.CommandRun(cmd, this);
+		SetTransfer(NULL);
+		if (m_Submitted)
+			Conn().GetMetrics().AddTransfer((unsigned int)m_FileSizes.size(), totalBytes, GetMonotonicTime() - start);
+		progress.Finish();
+		m_Progress = NULL;
 		
 		// The OutputState and other callbacks will now output to stdout.
 		// We just wrap up the communication here.
@@ -110,7 +196,16 @@ public:
 
 		if (hasFiles)
 		{
-			RunAndSendStatus(task, assetList);
+			if (HasErrors() || (!saveOnly && !m_Submitted))
+			{
+				// Ask the server since it is not known what was done
+				assetList.insert(assetList.end(), counterparts.begin(), counterparts.end());
+				RunAndSendStatus(task, assetList);
+			}
+			else
+			{
+				SendStateAfterSubmit(task, assetList, assetDepotPaths, counterparts, saveOnly);
+			}
 		} 
 		else 
 		{
@@ -123,45 +218,153 @@ public:
 		return true;
 	}
 
-	void AddMovedAssets(P4Task& task, VersionedAssetList& assetList)
+	// Make the changelist and hand the submit over to P4SubmitJobs. Unity is
+	// told the id of the job and the files as they are now. Returns false if
+	// the submit is to be done here after all.
+	bool StartBackgroundSubmit(P4Task& task, const VersionedAssetList& assetList)
+	{
+		task.CommandRun("change -i", this);
+		if (HasErrors())
+		{
+			Conn() << GetStatus();
+			RunAndSendStatus(task, assetList);
+			Conn().EndResponse();
+			return true;
+		}
+		if (m_Change.empty() || !task.GetSubmitJobs().Start(m_Change, assetList))
+			return false;
+
+		Conn().Log().Info() << "Submitting change " << m_Change << " in the background" << Endl;
+		Conn() << GetStatus();
+		Conn().InfoLine("Submitting change " + m_Change + " in the background. Ask with the submitStatus command.");
+		Conn().BeginList();
+		for (VersionedAssetList::const_iterator i = assetList.begin(); i != assetList.end(); ++i)
+			Conn() << *i;
+		Conn().EndList();
+		Conn().EndResponse();
+		return true;
+	}
+
+	// Size of the content sent for a depot file. Deleted files send none.
+	void AddFileSize(const std::string& depotPath, const std::string& localPath)
+	{
+		if (depotPath.empty())
+			return;
+		bool hasContent = !localPath.empty() && PathExists(localPath) && !IsDirectory(localPath);
+		m_FileSizes[depotPath] = hasContent ? GetFileLength(localPath) : 0;
+	}
+
+	void GetStatusWithDepotPaths(P4Task& task, VersionedAssetList& assetList, std::vector<std::string>& depotPaths)
 	{
+		P4StatusCommand* c = dynamic_cast<P4StatusCommand*>(LookupCommand("status"));
+		if (!c)
+		{
+			Conn().ErrorLine("Cannot locate status command");
+			return; // Returning this is just to keep things running.
+		}
+
 		// Get status for asset list to know what is moved and to ensure
 		// that we have correct clientFile paths (absolute paths)
-		RunAndGetStatus(task, assetList, assetList);
-
-		// Since the movedFile tag is in 'depot' format we need to get
-		// mapping from client file format to depot format so that we
-		// can compare moved_from with moved_to paths.
-		const std::vector<Mapping>& initialMappings = GetMappings(task, assetList);
-		std::set<std::string> initialDepotFiles;
+		VersionedAssetList result;
+		c->RunWithDepotPaths(task, assetList, result, depotPaths);
+		assetList.swap(result);
+	}
 
-		for (std::vector<Mapping>::const_iterator i = initialMappings.begin(); i != initialMappings.end(); ++i)
-			initialDepotFiles.insert(i->depotPath);
+	void AddMovedAssets(const VersionedAssetList& assetList, const std::vector<std::string>& depotPaths, VersionedAssetList& counterparts)
+	{
+		// The movedFile tag is in 'depot' format like the depot paths
+		std::set<std::string> initialDepotFiles(depotPaths.begin(), depotPaths.end());
 
 		// Include all moved-counterparts for files that was moved
 		// locally (either source or dest file) but where the counterparts in not
 		// int the initial list. This can happen if a user forgot to add either the
 		// to or from file when submitting.
+		counterparts.clear();
+		for (VersionedAssetList::const_iterator i = assetList.begin(); i != assetList.end(); ++i)
+		{
+			if (i->HasState(kMovedLocal) && initialDepotFiles.insert(i->GetMovedPath()).second)
+			{
+				// synthesize an asset. It is ok the path is depot format because it is the depot path for the spec.
+				counterparts.push_back(VersionedAsset(i->GetMovedPath()));
+				Conn().InfoLine(std::string("Included missing move counterpart: ") + i->GetMovedPath());
+			}
+		}
+	}
+
+	// The files the server lists as submitted are no longer opened and are at
+	// the head revision. Files that were deleted are gone. What others do with
+	// the files is as before. The rest are asked about again: files the submit
+	// options left unchanged or reopened, those the output does not tell about
+	// and the moved counterparts, known by depot path.
+	void SendStateAfterSubmit(P4Task& task, const VersionedAssetList& assetList, const std::vector<std::string>& depotPaths,
+							  const VersionedAssetList& counterparts, bool saveOnly)
+	{
+		const int kKeptStates = kCheckedOutRemote | kDeletedRemote | kAddedRemote | kLockedRemote | kExclusiveCheckout;
+
 		VersionedAssetList result;
-		result.reserve(assetList.size());
-		for (VersionedAssetList::iterator i = assetList.begin(); i != assetList.end(); ++i)
+		VersionedAssetList restat(counterparts);
+		result.reserve(assetList.size() + counterparts.size());
+		for (size_t n = 0; n < assetList.size(); ++n)
 		{
+			VersionedAssetList::const_iterator i = assetList.begin() + n;
+			if (!saveOnly && !i->IsFolder() && !IsSubmittedAsIs(n < depotPaths.size() ? depotPaths[n] : std::string()))
+			{
+				restat.push_back(*i);
+				continue;
+			}
+
 			result.push_back(*i);
-			if (i->HasState(kMovedLocal) && initialDepotFiles.find(i->GetMovedPath()) == initialDepotFiles.end())
+			if (saveOnly)
+				continue;
+
+			VersionedAsset& asset = result.back();
+			bool deleted = i->HasState(kDeletedLocal);
+			asset.SetState(i->GetState() & kKeptStates);
+			if (!deleted)
+				asset.AddState(kSynced);
+			if (PathExists(asset.GetPath()))
 			{
-				// synthesize an asset. It is ok the path is depot format because it will be mapped later on.
-				result.push_back(VersionedAsset(i->GetMovedPath()));
-				Conn().InfoLine(std::string("Included missing move counterpart: ") + i->GetMovedPath());
+				asset.AddState(kLocal);
+				if (IsReadOnly(asset.GetPath()))
+					asset.AddState(kReadOnly);
 			}
 		}
-		assetList.swap(result);
+
+		// Files left opened may be in another change now, as are those of a
+		// changelist just saved
+		P4OpenedIndex& index = task.GetOpenedIndex();
+		if (saveOnly)
+			index.Invalidate();
+		if (!restat.empty())
+		{
+			VersionedAssetList stated;
+			RunAndGetStatus(task, restat, stated);
+			for (VersionedAssetList::const_iterator i = stated.begin(); i != stated.end(); ++i)
+			{
+				if (i->HasState(kCheckedOutLocal | kAddedLocal | kDeletedLocal))
+					index.Invalidate();
+			}
+			result.insert(result.end(), stated.begin(), stated.end());
+		}
+		index.Update(result);
+
+		Conn().BeginList();
+		for (VersionedAssetList::const_iterator i = result.begin(); i != result.end(); ++i)
+			Conn() << *i;
+		Conn().EndList();
 	}
 	
+	bool IsSubmittedAsIs(const std::string& depotPath) const
+	{
+		return !depotPath.empty() && m_SubmittedFiles.find(depotPath) != m_SubmittedFiles.end() &&
+			m_ReopenedFiles.find(depotPath) == m_ReopenedFiles.end();
+	}
+
 	// Default handler of P4
 	virtual void InputData( StrBuf *buf, Error *err ) 
 	{
-		Conn().Log().Debug() << "Spec is:" << Endl;
-		Conn().Log().Debug() << m_Spec << Endl;
+		DEBUG_LOG(Conn().Log()) << "Spec is:" << Endl;
+		DEBUG_LOG(Conn().Log()) << m_Spec << Endl;
 		buf->Set(m_Spec.c_str());
 	}
 
@@ -169,12 +372,49 @@ public:
 	{
 		P4Command::OutputInfo(level, data);	
 
+		// "Change 12 submitted." or "Change 12 renamed change 13 and submitted."
 		std::string d(data);
+		if (StartsWith(d, "Change ") && EndsWith(d, " submitted."))
+			m_Submitted = true;
+
+		// "Change 12 created with 2 open file(s)." or "Change 12 updated."
+		if (StartsWith(d, "Change ") && (d.find(" created") != std::string::npos || EndsWith(d, " updated.")))
+			m_Change = d.substr(7, d.find(' ', 7) - 7);
+
+		// A submitted file e.g. "add //depot/Assets/file.txt#1"
+		std::string::size_type depot = d.find(" //");
+		std::string::size_type rev = d.rfind('#');
+		std::string depotFile;
+		if (depot != std::string::npos && rev != std::string::npos && rev > depot)
+		{
+			depotFile = d.substr(depot + 1, rev - depot - 1);
+			m_SubmittedFiles.insert(depotFile);
+		}
+
+		// A file the submit options leave opened or revert after the submit e.g.
+		// "//depot/Assets/file.txt#2 - opened for edit" or
+		// "//depot/Assets/file.txt#1 - unchanged, reverted"
+		if (StartsWith(d, "//"))
+		{
+			std::string file = d.substr(0, d.find(" - "));
+			m_ReopenedFiles.insert(file.substr(0, file.rfind('#')));
+		}
+
 		std::string::size_type i = d.find(m_ProjectPath);
 		if (i != std::string::npos)
 			d.replace(i, m_ProjectPath.length(), "");
 
-		Conn().Progress(-1, time(0) - m_StartTickTime, d);
+		if (m_Progress == NULL)
+			return;
+		if (!depotFile.empty())
+		{
+			std::map<std::string, unsigned long long>::const_iterator f = m_FileSizes.find(depotFile);
+			m_Progress->Step(f != m_FileSizes.end() ? f->second : 0, d);
+		}
+		else
+		{
+			m_Progress->Update(d);
+		}
 	}
 
 	virtual void HandleError( Error *err )
@@ -199,7 +439,12 @@ public:
 		P4Command::HandleError(err);
 	}
 	
-	time_t m_StartTickTime;
 	std::string m_ProjectPath;
+	std::string m_Change; // made by 'change -i' for a background submit
+	std::map<std::string, unsigned long long> m_FileSizes; // by depot path
+	std::set<std::string> m_SubmittedFiles; // depot paths the submit lists
+	std::set<std::string> m_ReopenedFiles; // and those it leaves opened or reverts
+	ProgressReporter* m_Progress;
+	bool m_Submitted;
 	
 } cSubmit("submit");
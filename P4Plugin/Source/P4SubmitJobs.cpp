@@ -0,0 +1,222 @@
+#include "P4SubmitJobs.h"
+#include "P4Command.h"
+#include "P4Task.h"
+#include "Utility.h"
+#include <exception>
+
+// Collects what the server says about a submit running in the background.
+// Nothing is sent to Unity from here.
+class P4SubmitJobCommand : public P4Command
+{
+public:
+	P4SubmitJobCommand(P4SubmitJobs& jobs, P4SubmitJobs::Job& job) : m_Jobs(jobs), m_Job(job) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args) { return false; }
+
+	// Errors go with the result of the job instead of taking the plugin offline
+	virtual void HandleError(Error* err)
+	{
+		if (err == NULL)
+			return;
+		VCSStatus s = errorToVCSStatus(*err);
+		GetStatus().insert(s.begin(), s.end());
+	}
+
+	virtual void OutputInfo(char level, const char* data)
+	{
+		// "Change 12 submitted." or "Change 12 renamed change 13 and submitted."
+		// and one "add //depot/Assets/file.txt#1" for each file
+		std::string d(data);
+		MutexLock lock(m_Jobs.m_Mutex);
+		if (StartsWith(d, "Change ") && EndsWith(d, " submitted."))
+			m_Job.submitted = true;
+		else if (d.find(" //") != std::string::npos && d.find('#') != std::string::npos)
+			++m_Job.filesSubmitted;
+	}
+
+private:
+	P4SubmitJobs& m_Jobs;
+	P4SubmitJobs::Job& m_Job;
+};
+
+P4SubmitJobs::P4SubmitJobs(P4Task& task)
+	: m_Task(task), m_Enabled(false), m_Finished(0)
+{
+}
+
+P4SubmitJobs::~P4SubmitJobs()
+{
+	WaitAll();
+	for (JobMap::iterator i = m_Jobs.begin(); i != m_Jobs.end(); ++i)
+		DeleteJob(i->second);
+}
+
+bool P4SubmitJobs::Start(const std::string& changelist, const VersionedAssetList& assets)
+{
+	MutexLock lock(m_Mutex);
+	if (m_Jobs.find(changelist) != m_Jobs.end())
+		return false;
+
+	Job* job = new Job();
+	job->owner = this;
+	job->changelist = changelist;
+	job->assets = assets;
+	job->start = GetMonotonicTime();
+	job->done = false;
+	job->submitted = false;
+	job->filesSubmitted = 0;
+	job->elapsed = 0;
+	job->capture = NULL;
+	if (!job->thread.Start(JobMain, job))
+	{
+		delete job;
+		return false;
+	}
+	m_Jobs[changelist] = job;
+	return true;
+}
+
+bool P4SubmitJobs::TakeReport(const std::string& changelist, Report& report)
+{
+	Job* job = NULL;
+	{
+		MutexLock lock(m_Mutex);
+		JobMap::iterator i = m_Jobs.find(changelist);
+		if (i == m_Jobs.end())
+			return false;
+		job = i->second;
+
+		report.done = job->done;
+		report.submitted = job->submitted;
+		report.filesSubmitted = job->filesSubmitted;
+		report.totalFiles = (unsigned int)job->assets.size();
+		report.elapsed = job->done ? job->elapsed : GetMonotonicTime() - job->start;
+		report.status = job->status;
+		report.assets = job->assets;
+		report.capture = job->capture;
+		job->capture = NULL;
+		if (!job->done)
+			return true;
+		m_Jobs.erase(i);
+	}
+	DeleteJob(job);
+	return true;
+}
+
+void P4SubmitJobs::GetJobs(std::vector<std::string>& changelists)
+{
+	MutexLock lock(m_Mutex);
+	changelists.clear();
+	for (JobMap::const_iterator i = m_Jobs.begin(); i != m_Jobs.end(); ++i)
+		changelists.push_back(i->first);
+}
+
+bool P4SubmitJobs::TakeFinished()
+{
+	MutexLock lock(m_Mutex);
+	if (m_Finished == 0)
+		return false;
+	--m_Finished;
+	return true;
+}
+
+bool P4SubmitJobs::IsSubmitting(const VersionedAssetList& assets, std::string& changelist)
+{
+	MutexLock lock(m_Mutex);
+	for (JobMap::const_iterator j = m_Jobs.begin(); j != m_Jobs.end(); ++j)
+	{
+		if (j->second->done)
+			continue;
+		const VersionedAssetList& submitting = j->second->assets;
+		for (VersionedAssetList::const_iterator a = assets.begin(); a != assets.end(); ++a)
+		{
+			for (VersionedAssetList::const_iterator s = submitting.begin(); s != submitting.end(); ++s)
+			{
+				if (a->IsFolder() ? StartsWith(s->GetPath(), a->GetPath()) : s->GetPath() == a->GetPath())
+				{
+					changelist = j->first;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool P4SubmitJobs::IsSubmitting(const std::string& changelist)
+{
+	MutexLock lock(m_Mutex);
+	JobMap::const_iterator i = m_Jobs.find(changelist);
+	return i != m_Jobs.end() && !i->second->done;
+}
+
+void P4SubmitJobs::TakeSubmitted(VersionedAssetList& assets)
+{
+	MutexLock lock(m_Mutex);
+	assets.insert(assets.end(), m_Submitted.begin(), m_Submitted.end());
+	m_Submitted.clear();
+}
+
+void P4SubmitJobs::WaitAll()
+{
+	std::vector<Job*> jobs;
+	{
+		MutexLock lock(m_Mutex);
+		for (JobMap::iterator i = m_Jobs.begin(); i != m_Jobs.end(); ++i)
+			jobs.push_back(i->second);
+	}
+	// Jobs are only removed by the thread calling this
+	for (std::vector<Job*>::iterator i = jobs.begin(); i != jobs.end(); ++i)
+	{
+		if ((*i)->thread.IsStarted())
+			(*i)->thread.Join();
+	}
+}
+
+void P4SubmitJobs::DeleteJob(Job* job)
+{
+	if (job->thread.IsStarted())
+		job->thread.Join();
+	delete job->capture;
+	delete job;
+}
+
+void P4SubmitJobs::JobMain(void* data)
+{
+	Job* job = (Job*)data;
+	job->owner->RunJob(*job);
+}
+
+void P4SubmitJobs::RunJob(Job& job)
+{
+	Connection& conn = *m_Task.m_Connection;
+	conn.BeginCapture("submitJob");
+	P4SubmitJobCommand command(*this, job);
+	try
+	{
+		ClientApi client;
+		if (m_Task.InitPooledClient(client))
+		{
+			m_Task.CommandRunOn(client, "submit -c " + job.changelist, &command, false);
+			Error err;
+			client.Final(&err);
+		}
+		else
+		{
+			command.GetStatus().insert(VCSStatusItem(VCSSEV_Error, "Could not connect to submit change " + job.changelist));
+		}
+	}
+	catch (std::exception& e)
+	{
+		command.GetStatus().insert(VCSStatusItem(VCSSEV_Error, std::string("Submit of change ") + job.changelist + " failed: " + e.what()));
+	}
+	ConnectionCapture* capture = conn.EndCapture();
+
+	MutexLock lock(m_Mutex);
+	job.done = true;
+	job.elapsed = GetMonotonicTime() - job.start;
+	job.status = command.GetStatus();
+	job.capture = capture;
+	m_Submitted.insert(m_Submitted.end(), job.assets.begin(), job.assets.end());
+	++m_Finished;
+	conn.Log().Info() << "Background submit of change " << job.changelist << (job.submitted ? " done" : " failed") << Endl;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <map>
+#include <string>
+#include "Metrics.h"
+#include "Status.h"
+#include "Thread.h"
+#include "VersionedAsset.h"
+
+class P4Task;
+struct ConnectionCapture;
+
+// Submits running on a connection of their own so that Unity does not wait
+// for the files to be transferred. The changelist is made on the main
+// connection first and its number is the id of the job. Unity asks how a job
+// is doing with the submitStatus custom command, see P4SubmitStatusCommand,
+// which also hands over the result once the job is done.
+class P4SubmitJobs
+{
+public:
+	// What Unity is told about a job
+	struct Report
+	{
+		bool done;
+		bool submitted;
+		unsigned int filesSubmitted;
+		unsigned int totalFiles;
+		Microseconds elapsed;
+		VCSStatus status;
+		VersionedAssetList assets;
+		ConnectionCapture* capture; // metrics of the job, owned by the caller
+	};
+
+	P4SubmitJobs(P4Task& task);
+	~P4SubmitJobs();
+
+	// Submits are run right away when not enabled
+	void SetEnabled(bool enabled) { m_Enabled = enabled; }
+	bool IsEnabled() const { return m_Enabled; }
+
+	// Start submitting the numbered changelist holding the assets
+	bool Start(const std::string& changelist, const VersionedAssetList& assets);
+
+	// Returns false for an unknown job. A job that is done is forgotten once
+	// reported.
+	bool TakeReport(const std::string& changelist, Report& report);
+
+	// Ids of the jobs not yet reported
+	void GetJobs(std::vector<std::string>& changelists);
+
+	// True once for each job done. What is known about the files is stale then.
+	bool TakeFinished();
+
+	// True if some of the assets, or files in the folders among them, are
+	// being submitted. Gives the changelist of the first such job.
+	bool IsSubmitting(const VersionedAssetList& assets, std::string& changelist);
+	bool IsSubmitting(const std::string& changelist);
+
+	// Adds the files of the jobs done since last asked. Unity is sent their
+	// state along with the next status, see P4StatusCommand.
+	void TakeSubmitted(VersionedAssetList& assets);
+
+	// Wait for all jobs e.g. on shutdown
+	void WaitAll();
+
+private:
+	P4SubmitJobs(const P4SubmitJobs&);
+	P4SubmitJobs& operator=(const P4SubmitJobs&);
+
+	struct Job
+	{
+		P4SubmitJobs* owner;
+		std::string changelist;
+		VersionedAssetList assets;
+		Microseconds start;
+		Thread thread;
+
+		// Guarded by m_Mutex
+		bool done;
+		bool submitted;
+		unsigned int filesSubmitted;
+		Microseconds elapsed;
+		VCSStatus status;
+		ConnectionCapture* capture;
+	};
+	typedef std::map<std::string, Job*> JobMap;
+
+	static void JobMain(void* data);
+	void RunJob(Job& job);
+	static void DeleteJob(Job* job);
+
+	friend class P4SubmitJobCommand;
+
+	P4Task& m_Task;
+	bool m_Enabled;
+	Mutex m_Mutex;
+	JobMap m_Jobs;
+	int m_Finished;
+	VersionedAssetList m_Submitted;
+};
@@ -0,0 +1,70 @@
+#include "P4Command.h"
+#include "P4SubmitJobs.h"
+#include "P4Task.h"
+#include "Utility.h"
+
+// Custom command telling how background submits are doing, see P4SubmitJobs.
+// Arguments are the changelist of the job or none for all jobs. Jobs that are
+// done are reported with their messages and the state of their files.
+class P4SubmitStatusCommand : public P4Command
+{
+public:
+	P4SubmitStatusCommand(const char* name) : P4Command(name) {}
+	virtual bool Run(P4Task& task, const CommandArgs& args)
+	{
+		ClearStatus();
+		Conn().Log().Info() << "submitStatus::Run()" << Endl;
+
+		P4SubmitJobs& jobs = task.GetSubmitJobs();
+		std::vector<std::string> changelists;
+		if (args.size() > 2)
+			changelists.assign(args.begin() + 2, args.end());
+		else
+			jobs.GetJobs(changelists);
+
+		VersionedAssetList doneAssets;
+		for (std::vector<std::string>::const_iterator i = changelists.begin(); i != changelists.end(); ++i)
+		{
+			P4SubmitJobs::Report report;
+			if (!jobs.TakeReport(*i, report))
+			{
+				Conn().WarnLine("No background submit of change " + *i);
+				continue;
+			}
+
+			time_t seconds = (time_t)(report.elapsed / 1000000);
+			if (!report.done)
+			{
+				int pct = report.totalFiles ? (int)(report.filesSubmitted * 100 / report.totalFiles) : -1;
+				Conn().Progress(pct > 100 ? 100 : pct, seconds, "Submitting change " + *i);
+				Conn().InfoLine("Change " + *i + " is being submitted: " + IntToString((int)report.filesSubmitted) +
+								" of " + IntToString((int)report.totalFiles) + " files");
+				continue;
+			}
+
+			if (report.capture != NULL)
+			{
+				Conn().SendCaptured(*report.capture);
+				delete report.capture;
+			}
+			Conn() << report.status;
+			if (report.submitted)
+				Conn().InfoLine("Change " + *i + " submitted");
+			else
+				Conn().ErrorLine("Change " + *i + " was not submitted");
+			doneAssets.insert(doneAssets.end(), report.assets.begin(), report.assets.end());
+		}
+
+		if (doneAssets.empty())
+		{
+			Conn().BeginList();
+			Conn().EndList();
+		}
+		else
+		{
+			RunAndSendStatus(task, doneAssets);
+		}
+		Conn().EndResponse();
+		return true;
+	}
+} cSubmitStatus("submitStatus");
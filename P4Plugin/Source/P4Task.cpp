@@ -7,6 +7,19 @@
 #include "CommandLine.h"
 #include "Utility.h"
 #include "FileSystem.h"
+#include "Thread.h"
+#include "P4Track.h"
+#include "P4BootstrapCache.h"
+#include "P4DescribeCache.h"
+#include "P4DescribeCommand.h"
+#include "P4HealthMonitor.h"
+#include "P4OpenedIndex.h"
+#include "P4PollCache.h"
+#include "P4StatusCache.h"
+#include "P4ConnectionPool.h"
+#include "P4ParallelTransfer.h"
+#include "P4SubmitJobs.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -30,10 +43,20 @@ class P4CheckRootCommand : public P4Command
 public:
 	P4CheckRootCommand(const char* name) : P4Command(name) { }
 	virtual bool Run(P4Task& task, const CommandArgs& args)
+	{
+		std::string cmd = BeginRun(task);
+		return EndRun(task, task.CommandRun(cmd, this));
+	}
+
+	virtual std::string BeginRun(P4Task& task)
 	{
 		ClearStatus();
+		return "where \"./testForProjectRootMapping\"";
+	}
 
-		if (!task.CommandRun("where \"./testForProjectRootMapping\"", this))
+	virtual bool EndRun(P4Task& task, bool ok)
+	{
+		if (!ok)
 		{
 			std::string errorMessage = GetStatusMessage();
 			Conn().Log().Fatal() << errorMessage << Endl;
@@ -110,6 +133,218 @@ VCSStatus errorToVCSStatus(Error& e)
 	return status;
 }
 
+bool IsConnectFailure(Error& e)
+{
+	StrBuf msg;
+	e.Fmt(&msg);
+	std::string value(msg.Text());
+	return value.find("Connect to server failed; check $P4PORT.") != std::string::npos ||
+		value.find("TCP connect to") != std::string::npos;
+}
+
+// Swallows the output of a command nobody is interested in anymore
+class DiscardingClientUser : public ClientUser
+{
+public:
+	void InputData( StrBuf *strbuf, Error *e ) { }
+	void HandleError( Error *err ) { }
+	void Message( Error *err ) { }
+	void OutputError( const char *errBuf ) { }
+	void OutputInfo( char level, const char *data ) { }
+	void OutputBinary( const char *data, int length ) { }
+	void OutputText( const char *data, int length ) { }
+	void OutputStat( StrDict *varList ) { }
+	void Prompt( Error *err, StrBuf &rsp, int noEcho, Error *e ) { }
+	void Prompt( Error *err, StrBuf &rsp, int noEcho, int noOutput, Error *e ) { }
+	void Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e ) { }
+	void Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, int noOutput, Error *e ) { }
+	void ErrorPause( char *errBuf, Error *e ) { }
+	void Help( const char *const *help ) { }
+};
+
+static DiscardingClientUser s_DiscardingClientUser;
+
+// Forwards all callbacks of a command to the P4Command running it while
+// counting the records and bytes received from the server.
+// Server performance tracking output is collected into track when given
+// instead of being passed on.
+class MeteredClientUser : public ClientUser
+{
+public:
+	MeteredClientUser(P4Command* target, Metrics& metrics, P4Track* track)
+		: m_Target(target), m_Metrics(metrics), m_Track(track),
+		  m_Connection(NULL), m_Previous(NULL), m_SkipDecided(false), m_Skipped(false) { }
+
+	// For a pipelined command: the command line is written as a verbose line
+	// when the output of the command starts and the output is discarded if
+	// the previous command failed.
+	void SetPipelined(Connection* conn, const std::string& command, MeteredClientUser* previous)
+	{
+		m_Connection = conn;
+		m_Command = command;
+		m_Previous = previous;
+	}
+
+	// Called once all replies are in for commands without any output
+	void Done() { Target(); }
+
+	bool IsSkipped()
+	{
+		// The previous command is done by the time this one gets any output
+		if (!m_SkipDecided)
+		{
+			m_Skipped = m_Previous != NULL && (m_Previous->IsSkipped() || m_Previous->m_Target->HasErrors());
+			m_SkipDecided = true;
+		}
+		return m_Skipped;
+	}
+
+	void InputData( StrBuf *strbuf, Error *e ) { Target()->InputData(strbuf, e); }
+	void HandleError( Error *err ) { m_Metrics.AddRecord(0); Target()->HandleError(err); }
+
+	void Message( Error *err )
+	{
+		m_Metrics.AddRecord(0);
+		if (m_Track && err->GetSeverity() == E_INFO)
+		{
+			StrBuf buf;
+			err->Fmt(&buf);
+			if (P4Track::IsTrackLine(buf.Text()))
+			{
+				ParseTrack(buf.Text());
+				return;
+			}
+		}
+		Target()->Message(err);
+	}
+
+	void OutputError( const char *errBuf ) { m_Metrics.AddRecord(strlen(errBuf)); Target()->OutputError(errBuf); }
+
+	void OutputInfo( char level, const char *data )
+	{
+		m_Metrics.AddRecord(strlen(data));
+		if (m_Track && P4Track::IsTrackLine(data))
+			ParseTrack(data);
+		else
+			Target()->OutputInfo(level, data);
+	}
+
+	void OutputBinary( const char *data, int length ) { m_Metrics.AddRecord(length); Target()->OutputBinary(data, length); }
+	void OutputText( const char *data, int length ) { m_Metrics.AddRecord(length); Target()->OutputText(data, length); }
+
+	void OutputStat( StrDict *varList )
+	{
+		size_t bytes = 0;
+		StrRef var, val;
+		for (int i = 0; varList->GetVar(i, var, val); ++i)
+			bytes += var.Length() + val.Length();
+		m_Metrics.AddRecord(bytes);
+		Target()->OutputStat(varList);
+	}
+
+	int OutputStatPartial( StrDict *varList ) { return Target()->OutputStatPartial(varList); }
+	void Prompt( Error *err, StrBuf &rsp, int noEcho, Error *e ) { Target()->Prompt(err, rsp, noEcho, e); }
+	void Prompt( Error *err, StrBuf &rsp, int noEcho, int noOutput, Error *e ) { Target()->Prompt(err, rsp, noEcho, noOutput, e); }
+	void Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e ) { Target()->Prompt(msg, rsp, noEcho, e); }
+	void Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, int noOutput, Error *e ) { Target()->Prompt(msg, rsp, noEcho, noOutput, e); }
+	void ErrorPause( char *errBuf, Error *e ) { Target()->ErrorPause(errBuf, e); }
+	void HandleUrl( const StrPtr *url ) { Target()->HandleUrl(url); }
+	void Edit( FileSys *f1, Error *e ) { Target()->Edit(f1, e); }
+	void Diff( FileSys *f1, FileSys *f2, int doPage, char *diffFlags, Error *e ) { Target()->Diff(f1, f2, doPage, diffFlags, e); }
+	void Diff( FileSys *f1, FileSys *f2, FileSys *fout, int doPage, char *diffFlags, Error *e ) { Target()->Diff(f1, f2, fout, doPage, diffFlags, e); }
+	void Merge( FileSys *base, FileSys *leg1, FileSys *leg2, FileSys *result, Error *e ) { Target()->Merge(base, leg1, leg2, result, e); }
+	int Resolve( ClientMerge *m, Error *e ) { return Target()->Resolve(m, e); }
+	int Resolve( ClientResolveA *r, int preview, Error *e ) { return Target()->Resolve(r, preview, e); }
+	void Help( const char *const *help ) { Target()->Help(help); }
+	FileSys* File( FileSysType type ) { return Target()->File(type); }
+	ClientProgress* CreateProgress( int type ) { return Target()->CreateProgress(type); }
+	int ProgressIndicator() { return Target()->ProgressIndicator(); }
+	void Finished() { Target()->Finished(); }
+	void SetOutputCharset( int c ) { Target()->SetOutputCharset(c); }
+	void DisableTmpCleanup() { Target()->DisableTmpCleanup(); }
+	void SetQuiet() { Target()->SetQuiet(); }
+	int CanAutoLoginPrompt() { return Target()->CanAutoLoginPrompt(); }
+	int IsOutputTaggedWithErrorLevel() { return Target()->IsOutputTaggedWithErrorLevel(); }
+	void SetTransfer( ClientTransfer* t ) { Target()->SetTransfer(t); }
+	ClientTransfer* GetTransfer() { return Target()->GetTransfer(); }
+	void SetSSOHandler( ClientSSO* t ) { Target()->SetSSOHandler(t); }
+	ClientSSO* GetSSOHandler() { return Target()->GetSSOHandler(); }
+
+private:
+	// Tracking output can hold several lines
+	void ParseTrack(const char* text)
+	{
+		std::stringstream ss(text);
+		std::string line;
+		while (std::getline(ss, line))
+			m_Track->ParseLine(line.c_str());
+	}
+
+	// The client library hands the rpc buffer and environment to the user
+	// object it runs with. Pass them on before every callback.
+	ClientUser* Target()
+	{
+		if (m_Connection != NULL)
+		{
+			if (IsSkipped())
+				return &s_DiscardingClientUser;
+			if (!m_Command.empty())
+			{
+				m_Connection->VerboseLine(m_Command);
+				m_Command.clear();
+			}
+		}
+		m_Target->varList = varList;
+		m_Target->enviro = enviro;
+		return m_Target;
+	}
+
+	P4Command* m_Target;
+	Metrics& m_Metrics;
+	P4Track* m_Track;
+
+	Connection* m_Connection;
+	std::string m_Command;
+	MeteredClientUser* m_Previous;
+	bool m_SkipDecided;
+	bool m_Skipped;
+};
+
+// Adds the time spent in a scope to the login overhead of the current command.
+// Nested scopes are included in the outermost one. The depth is per thread since
+// the background connect, the health monitor and the pool log in too.
+class ScopedLoginTimer
+{
+public:
+	ScopedLoginTimer(Metrics& metrics) : m_Metrics(metrics), m_Start(GetMonotonicTime())
+	{
+		s_Depth.Set((void*)((size_t)s_Depth.Get() + 1));
+	}
+	~ScopedLoginTimer()
+	{
+		size_t depth = (size_t)s_Depth.Get() - 1;
+		s_Depth.Set((void*)depth);
+		if (depth == 0)
+			m_Metrics.AddLoginTime(GetMonotonicTime() - m_Start);
+	}
+private:
+	Metrics& m_Metrics;
+	Microseconds m_Start;
+	static ThreadLocalPointer s_Depth;
+};
+
+ThreadLocalPointer ScopedLoginTimer::s_Depth;
+
+// Keeps the health monitor off the connection while a Unity command is handled
+class ScopedConnectionUse
+{
+public:
+	ScopedConnectionUse(P4HealthMonitor& monitor) : m_Monitor(monitor) { m_Monitor.BeginUse(); }
+	~ScopedConnectionUse() { m_Monitor.EndUse(); }
+private:
+	P4HealthMonitor& m_Monitor;
+};
+
 P4Task* P4Task::s_Singleton = NULL;
 
 // This class essentially manages the command line interface to the API and replies.  Commands are read from stdin and results
@@ -117,15 +352,41 @@ P4Task* P4Task::s_Singleton = NULL;
 P4Task::P4Task()
 {
 	m_P4Connect = false;
+	m_TrackThreshold = 0;
+	m_TrackRequested = false;
+	m_IncrementalSync = false;
 	m_IsLoginInProgress = false;
 	m_IsTestMode = false;
+	m_ConnectThread = NULL;
+	m_ConnectDone = 0;
+	m_ConnectCapture = NULL;
+	m_Monitor = new P4HealthMonitor(*this);
+	m_Pool = new P4ConnectionPool(*this);
+	m_Pool->SetSize(4);
+	m_PollCache = new P4PollCache();
+	m_StatusCache = new P4StatusCache();
+	m_DescribeCache = new P4DescribeCache();
+	m_OpenedIndex = new P4OpenedIndex();
+	m_Transfer = new P4ParallelTransfer(*this);
+	m_SubmitJobs = new P4SubmitJobs(*this);
+	m_UTF8Mode = false;
 	s_Singleton = this;
 	SetOnline(false);
 }
 
 P4Task::~P4Task()
 {
+	CancelBackgroundConnect();
+	m_Monitor->Stop();
 	Disconnect();
+	delete m_Pool;
+	delete m_Monitor;
+	delete m_PollCache;
+	delete m_StatusCache;
+	delete m_DescribeCache;
+	delete m_OpenedIndex;
+	delete m_Transfer;
+	delete m_SubmitJobs;
 }
 
 void P4Task::SetP4Port(const std::string& p)
@@ -202,6 +463,16 @@ void P4Task::SetP4Root(const std::string& r)
 	m_Root = r;
 }
 
+const std::string& P4Task::GetP4ClientUpdate() const
+{
+	return m_ClientUpdate;
+}
+
+void P4Task::SetP4ClientUpdate(const std::string& u)
+{
+	m_ClientUpdate = u;
+}
+
 void P4Task::SetProjectPath(const std::string& p)
 {
 	if (p != m_ProjectPathConfig)
@@ -238,12 +509,86 @@ const P4Streams& P4Task::GetP4Streams() const
 	return m_Streams;
 }
 
+void P4Task::SetTrackThreshold(int milliseconds)
+{
+	m_TrackThreshold = milliseconds > 0 ? milliseconds : 0;
+}
+
+int P4Task::GetTrackThreshold() const
+{
+	return m_TrackThreshold;
+}
+
+void P4Task::SetIncrementalSync(bool incremental)
+{
+	m_IncrementalSync = incremental;
+}
+
+bool P4Task::IsIncrementalSync() const
+{
+	return m_IncrementalSync;
+}
+
+void P4Task::SetConnectionPoolSize(int size)
+{
+	m_Pool->SetSize(size);
+}
+
+int P4Task::GetConnectionPoolSize() const
+{
+	return m_Pool->GetSize();
+}
+
+P4StatusCache& P4Task::GetStatusCache()
+{
+	return *m_StatusCache;
+}
+
+P4DescribeCache& P4Task::GetDescribeCache()
+{
+	m_DescribeCache->Open(m_PortConfig + "\t" + m_UserConfig + "\t" + m_ClientConfig, m_ClientUpdate);
+	return *m_DescribeCache;
+}
+
+P4OpenedIndex& P4Task::GetOpenedIndex()
+{
+	m_OpenedIndex->Open(m_PortConfig + "\t" + m_UserConfig + "\t" + m_ClientConfig);
+	return *m_OpenedIndex;
+}
+
+P4ParallelTransfer& P4Task::GetParallelTransfer()
+{
+	return *m_Transfer;
+}
+
+P4SubmitJobs& P4Task::GetSubmitJobs()
+{
+	return *m_SubmitJobs;
+}
+
+bool P4Task::IsTestMode() const
+{
+	return m_IsTestMode;
+}
+
 int P4Task::Run(const bool testmode)
 {
 	m_Connection = new Connection("./Library/p4plugin.log");
 	m_IsTestMode = testmode;
+	m_StatusCache->SetEnabled(!m_IsTestMode);
+	m_DescribeCache->SetEnabled(!m_IsTestMode);
+	m_OpenedIndex->SetEnabled(!m_IsTestMode);
+	m_Transfer->SetEnabled(!m_IsTestMode);
 	if (m_IsTestMode)
+	{
 		m_Connection->Log().Notice() << "Running on testing mode." << Endl;
+		m_Connection->SetProgressInterval(0);
+	}
+	else
+	{
+		m_Monitor->Start();
+	}
+	int result = 1;
 	try
 	{
 		UnityCommand cmd;
@@ -251,6 +596,7 @@ int P4Task::Run(const bool testmode)
 
 		for ( ;; )
 		{
+			RunIdleWork();
 			cmd = m_Connection->ReadCommand(args);
 
 			// Make it convenient to get the pipe even though the commands
@@ -258,50 +604,138 @@ int P4Task::Run(const bool testmode)
 			P4Command::s_Conn = m_Connection;
 
 			if (cmd == UCOM_Invalid)
-				return 1; // error
+				break; // error
 			else if (cmd == UCOM_Shutdown)
 			{
+				CancelBackgroundConnect();
 				m_Connection->EndResponse(); // good manner shutdown
-				return 0; // ok
+				result = 0; // ok
+				break;
 			}
 			else if (!Dispatch(cmd, args))
-				return 0; // ok
+			{
+				result = 0; // ok
+				break;
+			}
 		}
 	}
 	catch (std::exception& e)
 	{
 		m_Connection->Log().Fatal() << "Unhandled exception: " << e.what() << Endl;
 	}
-	return 1;
+
+	CancelBackgroundConnect();
+	m_Monitor->Stop();
+	m_SubmitJobs->WaitAll();
+
+	if (!m_Connection->GetMetrics().WriteFile("./Library/p4plugin-metrics.json"))
+		m_Connection->Log().Notice() << "Could not write metrics file" << Endl;
+	m_Connection->GetTracer().Close();
+	m_Connection->Log().Shutdown();
+	return result;
 }
 
 bool P4Task::Dispatch(UnityCommand cmd, const std::vector<std::string>& args)
 {
-	// Simple hack to test custom commands
+	// Custom commands are looked up by their own name. Only those listed here
+	// and told about in the plugin traits can be called, not every command.
+	const char* customCmds[] = { "submitStatus", 0 };
+	P4Command* p4c = NULL;
 	if (cmd == UCOM_CustomCommand)
 	{
-		m_Connection->WarnLine(std::string("You called the custom command ") + args[1]);
-		m_Connection->EndResponse();
-		return true;
+		for (int i = 0; customCmds[i] && args.size() > 1; ++i)
+		{
+			if (args[1] == customCmds[i])
+				p4c = LookupCommand(args[1]);
+		}
+
+		// Simple hack to test custom commands
+		if (!p4c)
+		{
+			m_Connection->WarnLine(std::string("You called the custom command ") + args[1]);
+			m_Connection->EndResponse();
+			return true;
+		}
 	}
 
+	TraceScope trace(m_Connection->GetTracer(), UnityCommandToString(cmd), "unity");
+
 	// Dispatch
-	P4Command* p4c = LookupCommand(UnityCommandToString(cmd));
+	if (!p4c)
+		p4c = LookupCommand(UnityCommandToString(cmd));
 	if (!p4c)
 	{
 		throw CommandException(cmd, std::string("unknown command"));
 	}
 
-	if (!p4c->Run(*this, args))
-		return false;
+	Microseconds queued = GetMonotonicTime();
+	ScopedConnectionUse use(*m_Monitor);
 
-	return true;
+	// Tell Unity what happened to the connection while it was idle
+	ConnectionCapture* report = m_Monitor->TakeReport();
+	if (report)
+	{
+		m_Connection->SendCaptured(*report);
+		delete report;
+	}
+
+	// Configuration is handled while connecting in the background but everything
+	// else needs the connection
+	if (cmd != UCOM_Config)
+		FinishBackgroundConnect(true);
+
+	m_Connection->GetMetrics().AddQueueWait(UnityCommandPriorityToString(UnityCommandToPriority(cmd)), GetMonotonicTime() - queued);
+
+	// Files of a submit done in the background have changed
+	if (m_SubmitJobs->TakeFinished())
+	{
+		m_StatusCache->Clear();
+		m_PollCache->Clear();
+		m_OpenedIndex->Clear();
+	}
+	m_StatusCache->BeginCommand(cmd);
+	m_OpenedIndex->BeginCommand(cmd);
+
+	// Let interactive commands go first by deferring background polls while the
+	// user is busy. Responses would differ from run to run in test mode.
+	if (m_IsTestMode)
+		return p4c->Run(*this, args);
+
+	if (m_PollCache->Answer(cmd, args, *m_Connection))
+		return true;
+
+	m_Connection->RecordResponse(m_PollCache->BeginCommand(cmd, args));
+	bool result = p4c->Run(*this, args);
+	m_Connection->RecordResponse(NULL);
+	m_PollCache->EndCommand(cmd, result && IsOnline());
+	return result;
+}
+
+void P4Task::RunIdleWork()
+{
+	// A few changelists are described at a time so that a command sent
+	// meanwhile only waits for a short round trip
+	const size_t kPrefetchStep = 10;
+
+	if (m_IsTestMode || m_ConnectThread != NULL || !IsConnected())
+		return;
+
+	std::vector<std::string> changes;
+	while (!m_Connection->HasInput() && m_DescribeCache->TakePending(kPrefetchStep, changes))
+	{
+		ScopedConnectionUse use(*m_Monitor);
+		P4DescribeCommand::Prefetch(*this, changes);
+		if (!IsOnline())
+			m_DescribeCache->SetPending(std::vector<std::string>());
+	}
 }
 
 bool P4Task::Reconnect()
 {
+	ScopedLoginTimer loginTimer(m_Connection->GetMetrics());
+	TraceScope trace(m_Connection->GetTracer(), "Reconnect", "login");
 	Disconnect();
-	m_OfflineReason.clear();
+	ClearOfflineReason();
 	// Ignore invalid configurations: empty server, empty username, empty workspace
 	if (m_PortConfig.empty())
 	{
@@ -319,6 +753,8 @@ bool P4Task::Reconnect()
 		return false;
 	}
 
+	m_Connection->GetMetrics().AddReconnect();
+
 	Error err;
 	m_Client.SetProg( "Unity" );
 	m_Client.SetVersion( "1.0" );
@@ -326,6 +762,7 @@ bool P4Task::Reconnect()
 	// Set the config because in case of reconnect the
 	// config has been reset
 	SetP4Root("");
+	SetP4ClientUpdate("");
 	m_Client.SetPort(m_PortConfig.c_str());
 	m_Client.SetUser(m_UserConfig.c_str());
 	if (m_PasswordConfig.empty())
@@ -334,6 +771,16 @@ bool P4Task::Reconnect()
 		m_Client.SetPassword(m_PasswordConfig.c_str());
 	m_Client.SetClient(m_ClientConfig.c_str());
 
+	// The same as p4 -Ztrack. Protocol variables can only be set before Init()
+	// and stay set, so once requested tracking output is always filtered.
+	if (m_TrackThreshold > 0)
+	{
+		m_Client.SetProtocol("track", "");
+		m_TrackRequested = true;
+	}
+
+	// Connect, and for ssl do the handshake
+	Microseconds handshakeStart = GetMonotonicTime();
 	m_Client.Init( &err );
 
 	VCSStatus status = errorToVCSStatus(err);
@@ -347,6 +794,7 @@ bool P4Task::Reconnect()
 		m_Client.Init( &err );
 		VCSStatus status = errorToVCSStatus(err);
 	}
+	m_Connection->GetMetrics().AddHandshakeTime(GetMonotonicTime() - handshakeStart);
 
 	if (status.size())
 	{
@@ -365,8 +813,13 @@ bool P4Task::Reconnect()
 	}
 
 	if( err.Test() )
+	{
+		if (IsConnectFailure(err))
+			m_Monitor->ReportUnreachable(m_PortConfig, GetOfflineReason().empty() ? "Could not connect to the perforce server." : GetOfflineReason());
 		return false;
+	}
 
+	m_Monitor->ReportReachable();
 	m_P4Connect = true;
 
 	m_Client.SetVar("enableStreams");
@@ -374,6 +827,10 @@ bool P4Task::Reconnect()
 	return true;
 }
 
+// Commands on pooled connections and background submits go offline from other
+// threads than the main one
+static Mutex s_OnlineMutex;
+
 void P4Task::NotifyOffline(const std::string& reason)
 {
 	const char* disableCmds[]  = {
@@ -387,10 +844,13 @@ void P4Task::NotifyOffline(const std::string& reason)
 		0
 	};
 
-	if (!s_Singleton->m_OfflineReason.empty() && !IsOnline())
-		return;
-
-	SetOnline(false);
+	{
+		MutexLock lock(s_OnlineMutex);
+		if (!s_Singleton->m_OfflineReason.empty() && !s_Singleton->m_IsOnline)
+			return;
+		s_Singleton->m_IsOnline = false;
+		s_Singleton->m_OfflineReason = reason;
+	}
 
 	int i = 0;
 	while (disableCmds[i])
@@ -399,7 +859,6 @@ void P4Task::NotifyOffline(const std::string& reason)
 		++i;
 	}
 	s_Singleton->m_Connection->Command(std::string("offline ") + reason, MAProtocol);
-	s_Singleton->m_OfflineReason = reason;
 }
 
 void P4Task::NotifyOnline()
@@ -414,8 +873,12 @@ void P4Task::NotifyOnline()
 		"submit", "unlock",
 		0
 	};
-	if (IsOnline())
-		return;
+	{
+		MutexLock lock(s_OnlineMutex);
+		if (s_Singleton->m_IsOnline)
+			return;
+		s_Singleton->m_IsOnline = true;
+	}
 
 	s_Singleton->m_Connection->Command("online", MAProtocol);
 	int i = 0;
@@ -424,19 +887,32 @@ void P4Task::NotifyOnline()
 		s_Singleton->m_Connection->Command(std::string("enableCommand ") + enableCmds[i], MAProtocol);
 		++i;
 	}
-	SetOnline(true);
 }
 
 void P4Task::SetOnline(bool isOnline)
 {
+	MutexLock lock(s_OnlineMutex);
 	s_Singleton->m_IsOnline = isOnline;
 }
 
 bool P4Task::IsOnline()
 {
+	MutexLock lock(s_OnlineMutex);
 	return s_Singleton->m_IsOnline;
 }
 
+std::string P4Task::GetOfflineReason()
+{
+	MutexLock lock(s_OnlineMutex);
+	return s_Singleton->m_OfflineReason;
+}
+
+void P4Task::ClearOfflineReason()
+{
+	MutexLock lock(s_OnlineMutex);
+	s_Singleton->m_OfflineReason.clear();
+}
+
 static std::string FormatFingerprintMessage(const std::string& statusMessage)
 {
 	std::string noNewlines = statusMessage;
@@ -449,17 +925,31 @@ static std::string FormatFingerprintMessage(const std::string& statusMessage)
 		"\n\nTrust this fingerprint going forward?";
 }
 
+// Asks the user to trust the server if it says so. Dialogs are only shown on
+// the main thread; a connect in the background or by the health monitor
+// leaves it to the next connect done for a command or the end of configuration.
+bool P4Task::ConfirmServerTrust(const VCSStatus& status)
+{
+	if (!HasServerFingerPrintError(status))
+		return false;
+	if (!Thread::IsMainThread())
+	{
+		m_Connection->Log().Notice() << "Server fingerprint needs to be trusted, left to the main thread" << Endl;
+		return false;
+	}
+	return ShowOKCancelDialogBox("Perforce Fingerprint Required", FormatFingerprintMessage(status.begin()->message));
+}
+
 bool P4Task::IsLoggedIn()
 {
+	TraceScope trace(m_Connection->GetTracer(), "IsLoggedIn", "login");
 	P4Command* p4c = LookupCommand("login");
 	std::vector<std::string> args;
 	args.push_back("login");
 	args.push_back("-s");
 	bool loggedIn = p4c->Run(*this, args);
 
-	if (HasServerFingerPrintError(p4c->GetStatus()) &&
-		ShowOKCancelDialogBox("Perforce Fingerprint Required",
-			FormatFingerprintMessage(p4c->GetStatus().begin()->message)))
+	if (ConfirmServerTrust(p4c->GetStatus()))
 	{
 		m_Connection->InfoLine("Prompting user for server fingerprint trust");
 		args.resize(1);
@@ -484,24 +974,10 @@ bool P4Task::IsLoggedIn()
 	return loggedIn;
 }
 
-bool P4Task::Login()
+// Log in on the current connection with the configured password or check
+// that a ticket is in place if there is none
+bool P4Task::Authenticate()
 {
-#if defined(_DEBUG)
-	ShowOKCancelDialogBox("You can attach a debugger now", std::string("Process id: ") + ToString(GetCurrentProcessId()));
-#endif
-
-	if (!IsConnected())
-	{
-		m_Connection->Log().Notice() << "Perforce server not connected. Ignoring login request." << Endl;
-		return false;
-	}
-
-	m_IsLoginInProgress = true;
-	P4Command* p4c = NULL;
-	std::vector<std::string> args;
-
-	SetOnline(true);
-
 	if (GetP4Password().empty())
 	{
 		m_Connection->Log().Notice() << "Perforce password is empty. Ignoring login request." << Endl;
@@ -509,21 +985,19 @@ bool P4Task::Login()
 		if (!loggedIn)
 		{
 			NotifyOffline("Login failed.");
-			m_IsLoginInProgress = false;
 			return false;
 		}
 	}
 	else
 	{
 		// Do the actual login
-		p4c = LookupCommand("login");
+		P4Command* p4c = LookupCommand("login");
+		std::vector<std::string> args;
 
 		args.push_back("login");
 		bool loggedIn = p4c->Run(*this, args);
 
-		if (HasServerFingerPrintError(p4c->GetStatus()) &&
-				ShowOKCancelDialogBox("Perforce Fingerprint Required",
-					FormatFingerprintMessage(p4c->GetStatus().begin()->message)))
+		if (ConfirmServerTrust(p4c->GetStatus()))
 		{
 			args.resize(1);
 			args.push_back("trust");
@@ -540,10 +1014,51 @@ bool P4Task::Login()
 		if (!loggedIn)
 		{
 			NotifyOffline("Login failed");
-			m_IsLoginInProgress = false;
 			return false; // error login
 		}
 	}
+	return true;
+}
+
+bool P4Task::Relogin()
+{
+	ScopedLoginTimer loginTimer(m_Connection->GetMetrics());
+	TraceScope trace(m_Connection->GetTracer(), "Relogin", "login");
+
+	m_Connection->Log().Info() << "Logging in again on the existing connection" << Endl;
+	m_Connection->GetMetrics().AddRelogin();
+	m_IsLoginInProgress = true;
+	bool loggedIn = Authenticate();
+	m_IsLoginInProgress = false;
+	return loggedIn;
+}
+
+bool P4Task::Login()
+{
+#if defined(_DEBUG)
+	ShowOKCancelDialogBox("You can attach a debugger now", std::string("Process id: ") + ToString(GetCurrentProcessId()));
+#endif
+
+	ScopedLoginTimer loginTimer(m_Connection->GetMetrics());
+	TraceScope trace(m_Connection->GetTracer(), "Login", "login");
+
+	if (!IsConnected())
+	{
+		m_Connection->Log().Notice() << "Perforce server not connected. Ignoring login request." << Endl;
+		return false;
+	}
+
+	m_IsLoginInProgress = true;
+	SetOnline(true);
+
+	if (!Authenticate())
+	{
+		m_IsLoginInProgress = false;
+		return false;
+	}
+
+	P4Command* p4c = NULL;
+	std::vector<std::string> args;
 
 	//N.B. if the server uses multi-factor authentication the first command after login will fail with an error message about login2.
 	//Currently first after login is the spec command, which is why message formatting for this error is there.
@@ -566,55 +1081,50 @@ bool P4Task::Login()
 		return false;
 	}
 
-	p4c = LookupCommand("checkroot");
-	args.clear();
-	args.push_back("checkroot");
-	res = p4c->Run(*this, args);
-	SendToConnection(*m_Connection, p4c->GetStatus(), MAProtocol);
-	VCSStatus& status = p4c->GetStatus();
-	if (!res)
+	// The root mapping check and streams are cached between sessions. Info
+	// is always fetched since it tells if the cache is for this server.
+	// Whatever is needed is sent in one go.
+	P4BootstrapCache cache(m_PortConfig, m_UserConfig, m_ClientConfig);
+	bool cached = !m_IsTestMode && cache.Load() && cache.IsValidFor(GetP4ClientUpdate(), GetP4Root());
+
+	std::vector<P4Command*> bootstrap;
+	if (!cached)
+		bootstrap.push_back(LookupCommand("checkroot"));
+	bootstrap.push_back(LookupCommand("info"));
+	if (!cached)
+		bootstrap.push_back(LookupCommand("streams"));
+	if (!RunBootstrapCommands(bootstrap))
 	{
-		for (VCSStatus::const_iterator i = status.begin(); i != status.end(); ++i)
+		m_IsLoginInProgress = false;
+		return false;
+	}
+
+	if (cached && P4BootstrapCache::GetServerIdentity(GetP4Info()) != cache.serverIdentity)
+	{
+		m_Connection->Log().Info() << "Bootstrap cache is for another server" << Endl;
+		cached = false;
+		bootstrap.clear();
+		bootstrap.push_back(LookupCommand("checkroot"));
+		bootstrap.push_back(LookupCommand("streams"));
+		if (!RunBootstrapCommands(bootstrap))
 		{
-			// some messages are fairly specific (e.g. wrong host info) and should be reported
-			// as the only message
-			if (i->message.find("can only be used from host") != std::string::npos)
-			{
-				NotifyOffline(i->message);
-			}
-			else
-			{
-				NotifyOffline("Couldn't fstat the project root directory. Please ensure that the selected workspace maps the project directory.");
-			}
 			m_IsLoginInProgress = false;
 			return false;
 		}
 	}
 
-	// Need to get Info
-	p4c = LookupCommand("info");
-	args.clear();
-	args.push_back("info");
-	res = p4c->Run(*this, args); // fetched root info
-	SendToConnection(*m_Connection, p4c->GetStatus(), MAProtocol);
-	if (!res)
+	if (cached)
 	{
-		NotifyOffline("Couldn't fetch server info from Perforce server");
-		m_IsLoginInProgress = false;
-		return false;
+		SetP4Streams(cache.streams);
 	}
-
-	// Need to get Streams if any
-	p4c = LookupCommand("streams");
-	args.clear();
-	args.push_back("streams");
-	res = p4c->Run(*this, args); // fetched root info
-	SendToConnection(*m_Connection, p4c->GetStatus(), MAProtocol);
-	if (!res)
+	else if (!m_IsTestMode && !GetP4ClientUpdate().empty())
 	{
-		NotifyOffline("Couldn't fetch client streams from perforce server");
-		m_IsLoginInProgress = false;
-		return false;
+		cache.serverIdentity = P4BootstrapCache::GetServerIdentity(GetP4Info());
+		cache.specUpdate = GetP4ClientUpdate();
+		cache.root = GetP4Root();
+		cache.streams = GetP4Streams();
+		if (!cache.serverIdentity.empty() && !cache.Save())
+			m_Connection->Log().Notice() << "Could not write bootstrap cache" << Endl;
 	}
 
 	// Upon login check if the client is know to the server and if not
@@ -657,6 +1167,7 @@ bool P4Task::Disconnect()
 
 	m_Client.Final( &err );
 	m_P4Connect = false;
+	m_Pool->Reset();
 	m_Info = P4Info();
 	m_Streams = P4Streams();
 
@@ -677,39 +1188,170 @@ bool P4Task::IsConnected()
     return (m_P4Connect && !m_Client.Dropped());
 }
 
-// Run a perforce command
-bool P4Task::CommandRun(const std::string& command, P4Command* client)
+void P4Task::StartBackgroundConnect()
 {
-	if (m_Connection->Log().GetLogLevel() != LOG_DEBUG)
-		m_Connection->Log().Info() << command << Endl;
+	if (m_IsTestMode || m_ConnectThread != NULL || IsConnected())
+		return;
+	if (m_PortConfig.empty() || m_UserConfig.empty() || m_ClientConfig.empty() || m_ProjectPathConfig.empty())
+		return;
 
-	m_Connection->VerboseLine(command);
+	m_Connection->Log().Info() << "Connecting in the background" << Endl;
+	m_ConnectDone = 0;
+	m_ConnectCapture = NULL;
+	m_ConnectThread = new Thread();
+	m_Monitor->BeginUse();
+	if (!m_ConnectThread->Start(BackgroundConnectMain, this))
+	{
+		// Connect on the first command instead
+		m_Monitor->EndUse();
+		delete m_ConnectThread;
+		m_ConnectThread = NULL;
+	}
+}
+
+void P4Task::BackgroundConnectMain(void* data)
+{
+	P4Task* task = (P4Task*)data;
+	Connection& conn = *task->m_Connection;
+	conn.BeginCapture("backgroundConnect");
+	try
+	{
+		if (task->Reconnect())
+			task->Login();
+	}
+	catch (std::exception& e)
+	{
+		conn.Log().Notice() << "Background connect failed: " << e.what() << Endl;
+	}
+	task->m_ConnectCapture = conn.EndCapture();
+	conn.Log().Flush();
+	task->m_Monitor->EndUse();
+	AtomicStore(&task->m_ConnectDone, 1);
+}
+
+void P4Task::FinishBackgroundConnect(bool wait)
+{
+	if (m_ConnectThread == NULL || (!wait && !AtomicLoad(&m_ConnectDone)))
+		return;
 
-	m_OfflineReason.clear();
+	m_ConnectThread->Join();
+	delete m_ConnectThread;
+	m_ConnectThread = NULL;
+
+	m_Connection->Log().Info() << "Background connect " << (IsOnline() ? "succeeded" : "failed") << Endl;
+	if (m_ConnectCapture)
+		m_Connection->SendCaptured(*m_ConnectCapture);
+	delete m_ConnectCapture;
+	m_ConnectCapture = NULL;
+}
+
+void P4Task::CancelBackgroundConnect()
+{
+	if (m_ConnectThread == NULL)
+		return;
+
+	m_ConnectThread->Join();
+	delete m_ConnectThread;
+	m_ConnectThread = NULL;
+	if (m_ConnectCapture)
+		m_Connection->GetMetrics().Add(m_ConnectCapture->metrics);
+	delete m_ConnectCapture;
+	m_ConnectCapture = NULL;
+
+	// Unity was never told about this connection so close it quietly
+	Error err;
+	m_Client.Final(&err);
+	m_P4Connect = false;
+	m_Pool->Reset();
+	m_Info = P4Info();
+	m_Streams = P4Streams();
+	ClearOfflineReason();
+	DisableUTF8Mode();
+	SetOnline(false);
+	m_Connection->Log().Info() << "Background connect cancelled" << Endl;
+}
+
+bool P4Task::KeepAlive()
+{
+	Metrics& metrics = m_Connection->GetMetrics();
+	Metrics::Mark mark = metrics.BeginServerCommand();
+	char* argv[] = { (char*)"-s" };
+	m_Client.SetArgv(1, argv);
+	m_Client.Run("info", &s_DiscardingClientUser);
+	metrics.EndServerCommand("keepAlive", mark);
+	return !m_Client.Dropped();
+}
+
+bool P4Task::PrepareConnection()
+{
+	ClearOfflineReason();
 	if (IsConnected())
 	{
+		ScopedLoginTimer loginTimer(m_Connection->GetMetrics());
+
 		// Make sure we have not been logged out
 		if (!m_IsLoginInProgress && !IsLoggedIn())
 		{
-			// relogin
-			if (!Reconnect() || !Login())
-				return false;
+			// An expired ticket and the like only need a new login. Only a broken
+			// transport or a changed configuration needs a new connection, which
+			// for ssl means a new handshake.
+			if (!IsOnline() || !IsConnected())
+			{
+				if (!Reconnect() || !Login())
+					return false;
+			}
+			else if (!Relogin())
+			{
+				// Start over if the connection broke while logging in
+				if (IsConnected() || !Reconnect() || !Login())
+					return false;
+			}
 		}
 	}
 	else
 	{
 		// Make sure commands run as part of a login request does not reconnect. But all other commands
 		// Should (re)establish the connection.
+		std::string reason;
 		if (m_IsLoginInProgress)
 			return false; // This is an error since we are trying to login and has been disconnect while doing that
+		else if (m_Monitor->IsServerDown(reason))
+		{
+			// Fail fast. The health monitor reconnects once the server is back.
+			NotifyOffline(reason);
+			return false;
+		}
 		else if (!Reconnect() || !Login())
 			return false; // Cannot do any commands when not connected and logged in.
 	}
+	return true;
+}
+
+// Run a perforce command
+bool P4Task::CommandRun(const std::string& command, P4Command* client)
+{
+	TraceScope trace(m_Connection->GetTracer(), command.substr(0, command.find(' ')), "p4");
+	if (m_Connection->GetTracer().IsEnabled())
+		m_Connection->GetTracer().AddArg("command", command.substr(0, 256));
+
+	// The command shows up in the debug log as a verbose line below
+	if (!m_Connection->Log().IsEnabled(LOG_DEBUG))
+		INFO_LOG(m_Connection->Log()) << command << Endl;
+
+	m_Connection->VerboseLine(command);
+
+	if (!PrepareConnection())
+		return false;
 
 	return CommandRunNoLogin(command, client);
 }
 
 bool P4Task::CommandRunNoLogin( const std::string &command, P4Command* client )
+{
+	return CommandRunOn(m_Client, command, client, m_TrackRequested);
+}
+
+bool P4Task::CommandRunOn(ClientApi& api, const std::string& command, P4Command* client, bool trackRequested)
 {
 	// Split out the arguments
 	int argc = 0;
@@ -719,14 +1361,268 @@ bool P4Task::CommandRunNoLogin( const std::string &command, P4Command* client )
 		return "No perforce command was passed";
 
 	if ( argc > 1 )
-		m_Client.SetArgv( argc-1, &argv[1] );
-
-	m_Client.Run(argv[0], client);
+		api.SetArgv( argc-1, &argv[1] );
+
+	Metrics& metrics = m_Connection->GetMetrics();
+	Metrics::Mark mark = metrics.BeginServerCommand();
+	P4Track track;
+	MeteredClientUser user(client, metrics, trackRequested ? &track : NULL);
+	if (client->IsTagged())
+		api.SetVar("tag"); // only for this run
+	api.Run(argv[0], &user);
+
+	ReportServerTrack(argv[0], GetMonotonicTime() - mark.start, track);
+	metrics.EndServerCommand(argv[0], mark);
 	CommandLineFreeArgs(argv);
 
 	return !client->HasErrors();
 }
 
+bool P4Task::CommandRunPipelined(const std::vector<P4Command*>& clients, std::vector<bool>& results, bool independent)
+{
+	results.assign(clients.size(), false);
+
+	std::vector<std::string> commands;
+	std::string name;
+	std::string last;
+	for (std::vector<P4Command*>::const_iterator i = clients.begin(); i != clients.end(); ++i)
+	{
+		commands.push_back((*i)->BeginRun(*this));
+		std::string current = commands.back().substr(0, commands.back().find(' '));
+		if (current == last)
+			continue;
+		if (!name.empty())
+			name += "+";
+		name += current;
+		last = current;
+	}
+
+	TraceScope trace(m_Connection->GetTracer(), name, "p4");
+	ClearOfflineReason();
+
+	Metrics& metrics = m_Connection->GetMetrics();
+	Metrics::Mark mark = metrics.BeginServerCommand();
+	std::vector<P4Track> tracks(clients.size());
+	std::vector<MeteredClientUser*> users;
+	for (size_t i = 0; i < clients.size(); ++i)
+	{
+		if (!m_Connection->Log().IsEnabled(LOG_DEBUG))
+			INFO_LOG(m_Connection->Log()) << commands[i] << Endl;
+
+		int argc = 0;
+		char** argv = CommandLineToArgv(commands[i].c_str(), &argc);
+		if (argv == 0 || argc == 0)
+			break;
+
+		if (argc > 1)
+			m_Client.SetArgv(argc - 1, &argv[1]);
+
+		MeteredClientUser* user = new MeteredClientUser(clients[i], metrics, m_TrackRequested ? &tracks[i] : NULL);
+		user->SetPipelined(m_Connection, commands[i], independent || users.empty() ? NULL : users.back());
+		users.push_back(user);
+		if (clients[i]->IsTagged())
+			m_Client.SetVar("tag"); // only for this run
+		m_Client.RunTag(argv[0], user);
+		CommandLineFreeArgs(argv);
+	}
+	m_Client.WaitTag();
+
+	Microseconds elapsed = GetMonotonicTime() - mark.start;
+	bool ok = users.size() == clients.size();
+	for (size_t i = 0; i < users.size(); ++i)
+	{
+		users[i]->Done();
+		ReportServerTrack(name, elapsed, tracks[i]);
+		if (users[i]->IsSkipped())
+			ok = false;
+		else
+			ok = (results[i] = clients[i]->EndRun(*this, !clients[i]->HasErrors())) && ok;
+		delete users[i];
+	}
+	metrics.EndServerCommand(name, mark);
+	return ok;
+}
+
+bool P4Task::CommandRunBatch(const std::vector<P4Command*>& clients, std::vector<bool>& results)
+{
+	results.assign(clients.size(), false);
+	if (clients.empty())
+		return true;
+
+	// The login is checked once for the batch, so its output comes before
+	// the command lines of the pipelined commands
+	if (!PrepareConnection())
+		return false;
+
+	INFO_LOG(m_Connection->Log()) << "Running " << clients.size() << " commands pipelined" << Endl;
+
+	bool ok = true;
+
+	// Bounds what the client library and the server buffer at a time
+	const size_t kBatchSize = 128;
+	for (size_t begin = 0; begin < clients.size(); begin += kBatchSize)
+	{
+		// Do not send anything more on a connection that has failed
+		if (!IsConnected() || m_Client.Dropped())
+			return false;
+
+		size_t end = begin + kBatchSize < clients.size() ? begin + kBatchSize : clients.size();
+		std::vector<P4Command*> batch(clients.begin() + begin, clients.begin() + end);
+		std::vector<bool> batchResults;
+		ok = CommandRunPipelined(batch, batchResults, true) && ok;
+		std::copy(batchResults.begin(), batchResults.end(), results.begin() + begin);
+	}
+	return ok;
+}
+
+bool P4Task::CommandRunParallel(const std::vector<std::string>& commands, const std::vector<P4Command*>& clients, std::vector<bool>& results)
+{
+	results.assign(commands.size(), false);
+
+	// Transcripts of the tests expect the login checks done by CommandRun()
+	bool parallel = !m_IsTestMode && m_Pool->IsEnabled() && commands.size() > 1;
+	for (size_t i = 0; parallel && i < commands.size(); ++i)
+		parallel = P4ConnectionPool::IsReadOnly(commands[i]);
+
+	bool ok = true;
+	if (!parallel)
+	{
+		for (size_t i = 0; i < commands.size(); ++i)
+			ok = (results[i] = CommandRun(commands[i], clients[i])) && ok;
+		return ok;
+	}
+
+	TraceScope trace(m_Connection->GetTracer(), "parallel", "p4");
+	m_Connection->GetTracer().AddArg("count", commands.size());
+	INFO_LOG(m_Connection->Log()) << "Running " << commands.size() << " commands on " << m_Pool->GetSize() << " connections" << Endl;
+
+	// The pooled connections use the ticket of the main one
+	if (!PrepareConnection())
+		return false;
+
+	std::vector<ConnectionCapture*> captures;
+	m_Pool->Run(commands, clients, captures, results);
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (captures[i] == NULL)
+		{
+			// No pooled connection could be made
+			results[i] = CommandRun(commands[i], clients[i]);
+		}
+		else
+		{
+			m_Connection->SendCaptured(*captures[i]);
+			delete captures[i];
+		}
+		ok = results[i] && ok;
+	}
+	return ok;
+}
+
+bool P4Task::InitPooledClient(ClientApi& client, StrDict* protocol)
+{
+	client.SetProg( "Unity" );
+	client.SetVersion( "1.0" );
+	client.SetPort(m_PortConfig.c_str());
+	client.SetUser(m_UserConfig.c_str());
+	if (m_PasswordConfig.empty())
+		client.SetIgnorePassword();
+	else
+		client.SetPassword(m_PasswordConfig.c_str());
+	client.SetClient(m_ClientConfig.c_str());
+	client.SetCwd(m_ProjectPathConfig.c_str());
+	if (m_UTF8Mode)
+	{
+		CharSetApi::CharSet cs = CharSetApi::UTF_8;
+		client.SetTrans( cs, cs, cs, cs );
+		client.SetCharset("utf8");
+	}
+	if (protocol != NULL)
+	{
+		StrRef var, val;
+		for (int i = 0; protocol->GetVar(i, var, val); ++i)
+			client.SetProtocol(var.Text(), val.Text());
+	}
+
+	Error err;
+	Microseconds handshakeStart = GetMonotonicTime();
+	client.Init(&err);
+	m_Connection->GetMetrics().AddHandshakeTime(GetMonotonicTime() - handshakeStart);
+	if (err.Test())
+	{
+		StrBuf msg;
+		err.Fmt(&msg);
+		m_Connection->Log().Notice() << "Could not open pooled connection: " << msg.Text() << Endl;
+		return false;
+	}
+
+	m_Connection->GetMetrics().AddReconnect();
+	client.SetVar("enableStreams");
+	client.SetProtocol("enableStreams", "");
+	return true;
+}
+
+bool P4Task::RunBootstrapCommands(const std::vector<P4Command*>& clients)
+{
+	std::vector<bool> results;
+	CommandRunPipelined(clients, results);
+
+	// Report the first failure as if the commands had been run one by one
+	for (size_t i = 0; i < clients.size(); ++i)
+	{
+		P4Command* p4c = clients[i];
+		SendToConnection(*m_Connection, p4c->GetStatus(), MAProtocol);
+		if (results[i])
+			continue;
+
+		if (p4c == LookupCommand("checkroot"))
+		{
+			VCSStatus& status = p4c->GetStatus();
+			for (VCSStatus::const_iterator j = status.begin(); j != status.end(); ++j)
+			{
+				// some messages are fairly specific (e.g. wrong host info) and should be reported
+				// as the only message
+				if (j->message.find("can only be used from host") != std::string::npos)
+				{
+					NotifyOffline(j->message);
+				}
+				else
+				{
+					NotifyOffline("Couldn't fstat the project root directory. Please ensure that the selected workspace maps the project directory.");
+				}
+				return false;
+			}
+		}
+		else if (p4c == LookupCommand("info"))
+		{
+			NotifyOffline("Couldn't fetch server info from Perforce server");
+			return false;
+		}
+		else
+		{
+			NotifyOffline("Couldn't fetch client streams from perforce server");
+			return false;
+		}
+	}
+	return true;
+}
+
+void P4Task::ReportServerTrack(const std::string& name, Microseconds elapsed, const P4Track& track)
+{
+	if (!track.IsValid() || m_TrackThreshold <= 0 || elapsed < (Microseconds)m_TrackThreshold * 1000)
+		return;
+
+	m_Connection->GetMetrics().AddServerTrack(track.lapse, track.dbLockWait, track.rpcSendTime + track.rpcReceiveTime);
+	m_Connection->Log().Notice() << "Slow command " << name << " took " << elapsed / 1000 << " ms: " << track << Endl;
+	if (m_Connection->GetTracer().IsEnabled())
+	{
+		m_Connection->GetTracer().AddArg("serverLapseUs", track.lapse);
+		m_Connection->GetTracer().AddArg("dbLockWaitUs", track.dbLockWait);
+		m_Connection->GetTracer().AddArg("rpcWaitUs", track.rpcSendTime + track.rpcReceiveTime);
+	}
+}
+
 bool P4Task::HasUnicodeNeededError( VCSStatus status )
 {
 	return StatusContains(status, "Unicode server permits only unicode enabled clients");
@@ -742,6 +1638,7 @@ void P4Task::EnableUTF8Mode()
 	CharSetApi::CharSet cs = CharSetApi::UTF_8;
 	m_Client.SetTrans( cs, cs, cs, cs );
 	m_Client.SetCharset("utf8");
+	m_UTF8Mode = true;
 }
 
 #if defined(_WIN32) || defined(_WINDOWS)
@@ -805,6 +1702,7 @@ bool P4Task::ShowOKCancelDialogBox(const std::string& windowTitle, const std::st
 void P4Task::DisableUTF8Mode()
 {
 	m_Client.SetCharset("");
+	m_UTF8Mode = false;
 	CharSetApi::CharSet cs = CharSetApi::NOCONV;
 	m_Client.SetTrans( cs, -2, -2, -2 );
 }
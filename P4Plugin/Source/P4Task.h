@@ -8,8 +8,22 @@
 #include <stdio.h>
 
 class P4Command;
+class P4ConnectionPool;
+class P4DescribeCache;
+class P4HealthMonitor;
+class P4OpenedIndex;
+class P4ParallelTransfer;
+class P4PollCache;
+class P4StatusCache;
+class P4SubmitJobs;
+class Thread;
+struct P4Track;
+struct ConnectionCapture;
 VCSStatus errorToVCSStatus(Error& e);
 
+// True if the error means the server could not be reached at all
+bool IsConnectFailure(Error& e);
+
 // This class essentially manages the command line interface to the API and replies.  Commands are read from stdin and results
 // written to stdout and errors to stderr.  All text based communications used tags to make the parsing easier on both ends.
 class P4Task
@@ -29,6 +43,8 @@ public:
 	const std::string& GetP4Password() const;
 	void SetP4Root(const std::string& r);
 	const std::string& GetP4Root() const;
+	void SetP4ClientUpdate(const std::string& u);
+	const std::string& GetP4ClientUpdate() const;
 	void SetProjectPath(const std::string& p);
 	const std::string& GetProjectPath() const;
 	void SetP4Info(const P4Info& info);
@@ -36,7 +52,37 @@ public:
 	void SetP4Streams(const P4Streams& s);
 	const P4Streams& GetP4Streams() const;
 
+	// Server performance tracking is requested on (re)connect when the threshold
+	// is above zero. Figures are logged for commands slower than the threshold.
+	void SetTrackThreshold(int milliseconds);
+	int GetTrackThreshold() const;
+
+	// Sync the requested files before the rest of their folders, see P4GetLatestCommand
+	void SetIncrementalSync(bool incremental);
+	bool IsIncrementalSync() const;
+
+	// Number of extra connections for running read-only commands in parallel
+	void SetConnectionPoolSize(int size);
+	int GetConnectionPoolSize() const;
+
+	// Results of recent status requests, see P4StatusCache
+	P4StatusCache& GetStatusCache();
+
+	// Files of submitted changelists for the current workspace, see P4DescribeCache
+	P4DescribeCache& GetDescribeCache();
+
+	// Files opened in the current workspace, see P4OpenedIndex
+	P4OpenedIndex& GetOpenedIndex();
+
+	// Settings and threads for parallel sync and submit
+	P4ParallelTransfer& GetParallelTransfer();
+
+	// Submits running in the background
+	P4SubmitJobs& GetSubmitJobs();
+
 	int Run(const bool testmode);
+	// Output must match the test transcripts exactly so nothing optional is done
+	bool IsTestMode() const;
 	bool IsConnected();
 	bool Reconnect();
 	bool Login();
@@ -48,14 +94,54 @@ public:
 	// Same as above but does not do any connect and login.
 	bool CommandRunNoLogin( const std::string& command, P4Command* client );
 
+	// Send the commands (see P4Command::BeginRun) without waiting for the reply
+	// to each one before sending the next. Does not do any connect and login.
+	// Replies are handled in order and look the same as when running the
+	// commands one by one. Output of commands after a failed one is discarded
+	// unless the commands are independent.
+	// results holds the outcome of each command.
+	// Returns true if all commands succeeded.
+	bool CommandRunPipelined(const std::vector<P4Command*>& clients, std::vector<bool>& results, bool independent = false);
+
+	// Run any number of independent commands pipelined in batches after the
+	// connect and login of CommandRun(). A failed command does not stop the
+	// others.
+	// results holds the outcome of each command.
+	// Returns true if all commands succeeded.
+	bool CommandRunBatch(const std::vector<P4Command*>& clients, std::vector<bool>& results);
+
+	// Run read-only commands (see P4ConnectionPool::IsReadOnly) in parallel on
+	// the connection pool, each with its own client. Output is sent in the order
+	// of the commands as if they had been run one by one with CommandRun(). Runs
+	// them one by one if the pool is disabled or a command is not read-only.
+	// results holds the outcome of each command.
+	// Returns true if all commands succeeded.
+	bool CommandRunParallel(const std::vector<std::string>& commands, const std::vector<P4Command*>& clients, std::vector<bool>& results);
+
 	bool Disconnect();
 
+	// Connect and login on a background thread as soon as server, user, workspace
+	// and project path are known. The first command then finds a connection that
+	// is ready. Does nothing in test mode or when already connected.
+	void StartBackgroundConnect();
+
+	// Send what the background connect reported to Unity as part of the current
+	// response. Waits for it to finish if wait is true. Otherwise does nothing
+	// until it has finished.
+	void FinishBackgroundConnect(bool wait);
+
+	// Wait for the background connect and throw away the connection it made,
+	// e.g. because the configuration it used has changed.
+	void CancelBackgroundConnect();
+
 	static void NotifyOffline(const std::string& reason);
 	static void NotifyOnline();
 
 	// Set but do not notify unity about it
 	static void SetOnline(bool isOnline);
 	static bool IsOnline();
+	static std::string GetOfflineReason();
+	static void ClearOfflineReason();
 	void Logout();
 	void DisableUTF8Mode();
 
@@ -63,13 +149,37 @@ private:
 
 	bool Dispatch(UnityCommand c, const std::vector<std::string>& args);
 
+	// Work left from earlier commands, done in small steps while Unity has no
+	// command waiting
+	void RunIdleWork();
+
 	void EnableUTF8Mode();
 	static bool ShowOKCancelDialogBox(const std::string& windowTitle, const std::string& message);
 
 	bool HasUnicodeNeededError(VCSStatus status);
 	bool HasServerFingerPrintError(VCSStatus status);
+	bool ConfirmServerTrust(const VCSStatus& status);
 	bool IsLoggedIn();
 
+	// Connect and login if needed before running a command
+	bool PrepareConnection();
+	bool CommandRunOn(ClientApi& api, const std::string& command, P4Command* client, bool trackRequested);
+	// Protocol variables are set before connecting, which is the only time they can be
+	bool InitPooledClient(ClientApi& client, StrDict* protocol = NULL);
+	bool Authenticate();
+
+	// Login again on the existing connection e.g. after the ticket expired
+	bool Relogin();
+
+	// Run commands needed after login pipelined and notify Unity about the first failure
+	bool RunBootstrapCommands(const std::vector<P4Command*>& clients);
+	void ReportServerTrack(const std::string& name, Microseconds elapsed, const P4Track& track);
+	static void BackgroundConnectMain(void* data);
+
+	// Cheap round trip on an idle connection so that it is not dropped.
+	// Returns false if the connection was lost.
+	bool KeepAlive();
+
 
 	bool m_IsOnline;
 	bool m_IsLoginInProgress;
@@ -80,8 +190,12 @@ private:
 	ClientApi       m_Client;
 	StrBuf          m_Spec;
 	std::string		m_Root;
+	std::string		m_ClientUpdate;
 	P4Info          m_Info;
 	P4Streams       m_Streams;
+	int             m_TrackThreshold;
+	bool            m_TrackRequested;
+	bool            m_IncrementalSync;
 
 	std::string m_PortConfig;
 	std::string m_UserConfig;
@@ -90,12 +204,31 @@ private:
 	std::string m_ProjectPathConfig;
 	std::string m_OfflineReason;
 
+	// Background connect. m_ConnectCapture is set by the thread before m_ConnectDone.
+	Thread*            m_ConnectThread;
+	volatile long      m_ConnectDone;
+	ConnectionCapture* m_ConnectCapture;
+
+	P4HealthMonitor* m_Monitor;
+	P4ConnectionPool* m_Pool;
+	P4PollCache* m_PollCache;
+	P4StatusCache* m_StatusCache;
+	P4DescribeCache* m_DescribeCache;
+	P4OpenedIndex* m_OpenedIndex;
+	P4ParallelTransfer* m_Transfer;
+	P4SubmitJobs* m_SubmitJobs;
+	bool m_UTF8Mode;
+
 	// Command execution
 	std::string m_CommandOutput;
 
 	Connection* m_Connection;
 
 	friend class P4Command;
+	friend class P4HealthMonitor;
+	friend class P4ConnectionPool;
+	friend class P4ParallelTransfer;
+	friend class P4SubmitJobs;
 	static P4Task* s_Singleton;
 };
 
@@ -0,0 +1,88 @@
+#include "P4Track.h"
+#include <stdio.h>
+#include <string.h>
+#include <iomanip>
+#include <sstream>
+
+static const char* kTrackPrefix = "--- ";
+
+static Microseconds SecondsToMicroseconds(double s)
+{
+	return s > 0.0 ? (Microseconds)(s * 1000000.0 + 0.5) : 0;
+}
+
+P4Track::P4Track()
+	: lapse(0), dbLockWait(0),
+	  rpcMessagesIn(0), rpcMessagesOut(0), rpcMegabytesIn(0), rpcMegabytesOut(0),
+	  rpcSendTime(0), rpcReceiveTime(0), lines(0)
+{
+}
+
+bool P4Track::IsTrackLine(const char* line)
+{
+	return strncmp(line, kTrackPrefix, 4) == 0;
+}
+
+// Examples of the lines we are interested in:
+//	--- lapse .123s
+//	--- rpc msgs/size in+out 2+3/0mb+0mb himarks 795800/795800 snd/rcv .000s/.001s
+//	---   total lock wait+held read/write 0ms+1ms/0ms+0ms
+bool P4Track::ParseLine(const char* line)
+{
+	if (!IsTrackLine(line))
+		return false;
+
+	++lines;
+	const char* p = line + 4;
+	while (*p == ' ')
+		++p;
+
+	double seconds = 0.0;
+	if (sscanf(p, "lapse %lfs", &seconds) == 1)
+	{
+		lapse += SecondsToMicroseconds(seconds);
+		return true;
+	}
+
+	unsigned int in = 0, out = 0, mbIn = 0, mbOut = 0;
+	if (sscanf(p, "rpc msgs/size in+out %u+%u/%umb+%umb", &in, &out, &mbIn, &mbOut) == 4)
+	{
+		rpcMessagesIn += in;
+		rpcMessagesOut += out;
+		rpcMegabytesIn += mbIn;
+		rpcMegabytesOut += mbOut;
+
+		const char* times = strstr(p, "snd/rcv ");
+		double snd = 0.0, rcv = 0.0;
+		if (times && sscanf(times, "snd/rcv %lfs/%lfs", &snd, &rcv) == 2)
+		{
+			rpcSendTime += SecondsToMicroseconds(snd);
+			rpcReceiveTime += SecondsToMicroseconds(rcv);
+		}
+		return true;
+	}
+
+	const char* locks = strstr(p, "lock wait+held read/write ");
+	unsigned int readWait = 0, readHeld = 0, writeWait = 0, writeHeld = 0;
+	if (locks && sscanf(locks, "lock wait+held read/write %ums+%ums/%ums+%ums", &readWait, &readHeld, &writeWait, &writeHeld) == 4)
+		dbLockWait += (Microseconds)(readWait + writeWait) * 1000;
+
+	return true;
+}
+
+static std::string FormatSeconds(Microseconds t)
+{
+	std::stringstream ss;
+	ss << t / 1000000 << '.' << std::setw(3) << std::setfill('0') << (t % 1000000) / 1000 << "s";
+	return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const P4Track& track)
+{
+	os << "server lapse " << FormatSeconds(track.lapse)
+	   << ", db lock wait " << FormatSeconds(track.dbLockWait)
+	   << ", rpc msgs in+out " << track.rpcMessagesIn << "+" << track.rpcMessagesOut
+	   << " size " << track.rpcMegabytesIn << "mb+" << track.rpcMegabytesOut << "mb"
+	   << " snd/rcv " << FormatSeconds(track.rpcSendTime) << "/" << FormatSeconds(track.rpcReceiveTime);
+	return os;
+}
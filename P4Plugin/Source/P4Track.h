@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include "Metrics.h"
+
+// Server performance tracking figures of a single command. Sent by the server
+// as "--- " prefixed info lines when the client asks for it with the "track"
+// protocol variable (p4 -Ztrack).
+struct P4Track
+{
+	P4Track();
+
+	// Returns false if the line is not tracking output
+	bool ParseLine(const char* line);
+	bool IsValid() const { return lines > 0; }
+
+	static bool IsTrackLine(const char* line);
+
+	Microseconds lapse;
+	Microseconds dbLockWait;    // read and write lock waits summed over all tables
+	unsigned int rpcMessagesIn;
+	unsigned int rpcMessagesOut;
+	unsigned int rpcMegabytesIn;
+	unsigned int rpcMegabytesOut;
+	Microseconds rpcSendTime;
+	Microseconds rpcReceiveTime;
+	int lines;
+};
+
+std::ostream& operator<<(std::ostream& os, const P4Track& track);
@@ -2,6 +2,9 @@
 #include "Utility.h"
 #include <algorithm>
 #include <functional>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
 
 int ActionToState(const std::string& action, const std::string& headAction,
 				  const std::string& haveRev, const std::string& headRev)
@@ -79,71 +82,342 @@ int ActionToState(const std::string& action, const std::string& headAction,
 }
 
 
+// Perforce wildcards use hex values. The characters below must be swapped
+// for their %xx codes when talking to the server and back again when reading
+// paths from the server. Paths almost never contain any of them so the
+// codec below scans for the special bytes and copies the clean spans in bulk.
+static const char* const kWildcardCodes[256] = {
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,"%23",0,"%25",0,0,0,0,"%2A",0,0,0,0,0, // '#' '%' '*'
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	"%40",0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,         // '@'
+};
+
+// Decode "%xx" where x1 is '2' or '4'. Returns 0 if not a wildcard code.
+static inline char WildcardFromCode(char x1, char x2)
+{
+	if (x1 == '2')
+	{
+		if (x2 == '3') return '#';
+		if (x2 == '5') return '%';
+		if (x2 == 'A') return '*';
+	}
+	else if (x1 == '4' && x2 == '0')
+	{
+		return '@';
+	}
+	return 0;
+}
+
+// P4_WILDCARD_SCALAR leaves out the vector code, e.g. to test the scalar code
+// on a machine that would not use it
+#if defined(P4_WILDCARD_SCALAR)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define P4_WILDCARD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define P4_WILDCARD_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && (defined(P4_WILDCARD_AVX2) || defined(P4_WILDCARD_SSE2))
+#include <intrin.h>
+static inline unsigned LowestBit(unsigned mask)
+{
+	unsigned long i;
+	_BitScanForward(&i, mask);
+	return (unsigned)i;
+}
+#elif defined(P4_WILDCARD_AVX2) || defined(P4_WILDCARD_SSE2)
+static inline unsigned LowestBit(unsigned mask)
+{
+	return (unsigned)__builtin_ctz(mask);
+}
+#endif
+
+// Return the first position in [p, end) holding '%' or, if allChars is set,
+// any of the wildcard characters. Returns end if there is none.
+static const char* FindWildcard(const char* p, const char* end, bool allChars)
+{
+#if defined(P4_WILDCARD_AVX2)
+	const __m256i percent = _mm256_set1_epi8('%');
+	const __m256i hash = _mm256_set1_epi8('#');
+	const __m256i at = _mm256_set1_epi8('@');
+	const __m256i star = _mm256_set1_epi8('*');
+	while (end - p >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i m = _mm256_cmpeq_epi8(v, percent);
+		if (allChars)
+			m = _mm256_or_si256(_mm256_or_si256(m, _mm256_cmpeq_epi8(v, hash)),
+								_mm256_or_si256(_mm256_cmpeq_epi8(v, at), _mm256_cmpeq_epi8(v, star)));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+		if (mask)
+			return p + LowestBit(mask);
+		p += 32;
+	}
+#elif defined(P4_WILDCARD_SSE2)
+	const __m128i percent = _mm_set1_epi8('%');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i at = _mm_set1_epi8('@');
+	const __m128i star = _mm_set1_epi8('*');
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i m = _mm_cmpeq_epi8(v, percent);
+		if (allChars)
+			m = _mm_or_si128(_mm_or_si128(m, _mm_cmpeq_epi8(v, hash)),
+							 _mm_or_si128(_mm_cmpeq_epi8(v, at), _mm_cmpeq_epi8(v, star)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(m);
+		if (mask)
+			return p + LowestBit(mask);
+		p += 16;
+	}
+#endif
+	// Scalar fallback and tail
+	if (allChars)
+	{
+		for ( ; p != end; ++p)
+			if (kWildcardCodes[(unsigned char)*p])
+				return p;
+	}
+	else
+	{
+		for ( ; p != end; ++p)
+			if (*p == '%')
+				return p;
+	}
+	return end;
+}
+
+size_t WildcardsAddedLength(const char* path, size_t len)
+{
+	const char* end = path + len;
+	size_t result = len;
+	for (const char* p = FindWildcard(path, end, true); p != end; p = FindWildcard(p + 1, end, true))
+		result += 2;
+	return result;
+}
+
+char* WildcardsAdd(const char* path, size_t len, char* out)
+{
+	const char* end = path + len;
+	const char* p = path;
+	while (p != end)
+	{
+		const char* w = FindWildcard(p, end, true);
+		memcpy(out, p, w - p);
+		out += w - p;
+		if (w == end)
+			break;
+		const char* code = kWildcardCodes[(unsigned char)*w];
+		out[0] = code[0];
+		out[1] = code[1];
+		out[2] = code[2];
+		out += 3;
+		p = w + 1;
+	}
+	return out;
+}
+
+char* WildcardsRemove(const char* path, size_t len, char* out)
+{
+	const char* end = path + len;
+	const char* p = path;
+	while (p != end)
+	{
+		const char* w = FindWildcard(p, end, false);
+		memcpy(out, p, w - p);
+		out += w - p;
+		if (w == end)
+			break;
+		char c = end - w >= 3 ? WildcardFromCode(w[1], w[2]) : 0;
+		if (c)
+		{
+			*out++ = c;
+			p = w + 3;
+		}
+		else
+		{
+			*out++ = '%';
+			p = w + 1;
+		}
+	}
+	return out;
+}
+
 std::string WildcardsAdd(const std::string& pathIn)
 {
-	// Perforce wildcards use hex values.  
-	// The following characters below must be swapped for these
-	std::string path = Replace (pathIn, "%", "%25"); // Must be 1st :)
-	path = Replace (path, "#", "%23");
-	path = Replace (path, "@", "%40");
-	return Replace (path, "*", "%2A");
+	size_t len = WildcardsAddedLength(pathIn.data(), pathIn.length());
+	if (len == pathIn.length())
+		return pathIn;
+	std::string path(len, '\0');
+	WildcardsAdd(pathIn.data(), pathIn.length(), &path[0]);
+	return path;
 }
 
 
 std::string WildcardsRemove (const std::string& pathIn)
 {
-	std::string path = Replace (pathIn, "%23", "#");
-	path = Replace (path, "%40", "@");
-	path = Replace (path, "%2A", "*");
-	return Replace (path, "%25", "%"); // Must do this last or we could convert an actual % to another wildcard
+	if (pathIn.find('%') == std::string::npos)
+		return pathIn;
+	std::string path(pathIn.length(), '\0');
+	char* end = WildcardsRemove(pathIn.data(), pathIn.length(), &path[0]);
+	path.resize(end - path.data());
+	return path;
 }	
 
 
-std::string ResolvedPath(const VersionedAsset& asset, int flags)
+static size_t ResolvedPathLength(const VersionedAsset& asset, int flags)
 {
-	std::string path = asset.GetPath();
-	
+	const std::string& path = asset.GetPath();
+	size_t len = (flags & kPathWild) ? WildcardsAddedLength(path.data(), path.length()) : path.length();
+
+	if (asset.IsFolder())
+		len += (flags & kPathRecursive) ? 3 : 1;
+	return len;
+}
+
+static char* WriteResolvedPath(const VersionedAsset& asset, int flags, char* out)
+{
+	const std::string& path = asset.GetPath();
+
 	if (flags & kPathWild)
-		path = WildcardsAdd(path);
-	
+	{
+		out = WildcardsAdd(path.data(), path.length(), out);
+	}
+	else
+	{
+		memcpy(out, path.data(), path.length());
+		out += path.length();
+	}
+
 	if (asset.IsFolder())
-		path += (flags & kPathRecursive) ? "..." : "*";
+	{
+		if (flags & kPathRecursive)
+		{
+			memcpy(out, "...", 3);
+			out += 3;
+		}
+		else
+		{
+			*out++ = '*';
+		}
+	}
+	return out;
+}
 
+static char* WriteString(const std::string& s, char* out)
+{
+	memcpy(out, s.data(), s.length());
+	return out + s.length();
+}
+
+std::string ResolvedPath(const VersionedAsset& asset, int flags)
+{
+	std::string path(ResolvedPathLength(asset, flags), '\0');
+	if (!path.empty())
+		WriteResolvedPath(asset, flags, &path[0]);
 	return path;
 }
 
+PathListBuilder::PathListBuilder(VersionedAssetList::const_iterator b,
+								 VersionedAssetList::const_iterator e,
+								 int flags, const std::string& delim, const std::string& postfix)
+	: m_Begin(b), m_End(e), m_Flags(flags), m_Delim(delim), m_Postfix(postfix), m_Length(0)
+{
+	ComputeLength();
+}
 
-std::string ResolvePaths(VersionedAssetList::const_iterator b,
-					VersionedAssetList::const_iterator e,
-					int flags, const std::string& delim, const std::string& postfix)
+PathListBuilder::PathListBuilder(const VersionedAssetList& list, int flags,
+								 const std::string& delim, const std::string& postfix)
+	: m_Begin(list.begin()), m_End(list.end()), m_Flags(flags), m_Delim(delim), m_Postfix(postfix), m_Length(0)
 {
-	std::string paths;
-	
-	for (VersionedAssetList::const_iterator i = b; i != e; i++) 
+	ComputeLength();
+}
+
+void PathListBuilder::ComputeLength()
+{
+	for (VersionedAssetList::const_iterator i = m_Begin; i != m_End; ++i)
+	{
+		if (m_Length)
+			m_Length += m_Delim.length();
+		if (IsSkipped(*i))
+			continue;
+		m_Length += ResolvedPathLength(*i, m_Flags) + m_Postfix.length() + 3; // quotes and trailing space
+	}
+}
+
+bool PathListBuilder::IsSkipped(const VersionedAsset& asset) const
+{
+	return (m_Flags & kPathSkipFolders) && !(m_Flags & kPathRecursive) && asset.IsFolder();
+}
+
+void PathListBuilder::AppendTo(std::string& target) const
+{
+	if (IsEmpty())
+		return;
+
+	size_t offset = target.length();
+	target.resize(offset + m_Length);
+	char* start = &target[offset];
+	char* out = start;
+
+	for (VersionedAssetList::const_iterator i = m_Begin; i != m_End; ++i)
+	{
+		if (out != start)
+			out = WriteString(m_Delim, out);
+		if (IsSkipped(*i))
+			continue;
+		*out++ = '"';
+		out = WriteResolvedPath(*i, m_Flags, out);
+		out = WriteString(m_Postfix, out);
+		*out++ = '"';
+		*out++ = ' ';
+	}
+}
+
+void PathListBuilder::AppendTo(std::vector<std::string>& argv) const
+{
+	argv.reserve(argv.size() + std::distance(m_Begin, m_End));
+	for (VersionedAssetList::const_iterator i = m_Begin; i != m_End; ++i)
 	{
-		if (!paths.empty())
-			paths += delim;
-		if ((flags & kPathSkipFolders) && !(flags & kPathRecursive) && i->IsFolder())
+		if (IsSkipped(*i))
 			continue;
-		paths += "\"";
-		paths += ResolvedPath(*i, flags);
-		paths += postfix;
-		paths += "\" ";
+		argv.push_back(std::string());
+		std::string& arg = argv.back();
+		arg.resize(ResolvedPathLength(*i, m_Flags));
+		if (!arg.empty())
+			WriteResolvedPath(*i, m_Flags, &arg[0]);
 	}
+}
+
+std::string PathListBuilder::ToString() const
+{
+	std::string paths;
+	AppendTo(paths);
 	return paths;
 }
 
+std::ostream& operator<<(std::ostream& os, const PathListBuilder& paths)
+{
+	return os << paths.ToString();
+}
+
+std::string ResolvePaths(VersionedAssetList::const_iterator b,
+					VersionedAssetList::const_iterator e,
+					int flags, const std::string& delim, const std::string& postfix)
+{
+	return PathListBuilder(b, e, flags, delim, postfix).ToString();
+}
+
 void ResolvePaths(std::vector<std::string>& result, 
 				  VersionedAssetList::const_iterator b,
 				  VersionedAssetList::const_iterator e,
 				  int flags, const std::string& delim)
 {
-	for (VersionedAssetList::const_iterator i = b; i != e; i++) 
-	{
-		if ((flags & kPathSkipFolders) && !(flags & kPathRecursive) && i->IsFolder())
-			continue;
-		result.push_back(ResolvedPath(*i, flags));
-	}
+	PathListBuilder(b, e, flags).AppendTo(result);
 }
 
 std::string ResolvePaths(const VersionedAssetList& list, int flags, const std::string& delim, const std::string& postfix)
@@ -177,3 +451,57 @@ void Partition(const StateFilter& filter,
 	l2_Out.insert(l2_Out.end(), bound, l1_InOut.end());
 	l1_InOut.resize(distance(l1_InOut.begin(), bound));
 }
+
+void RemoveOverlappingPaths(VersionedAssetList& assets, bool recursive)
+{
+	if (assets.size() < 2)
+		return;
+
+	// Sorted, paths below a folder follow the folder
+	std::vector<std::pair<std::string, size_t> > sorted;
+	sorted.reserve(assets.size());
+	for (size_t i = 0; i < assets.size(); ++i)
+		sorted.push_back(std::make_pair(assets[i].GetPath(), i));
+	std::sort(sorted.begin(), sorted.end());
+
+	std::vector<char> keep(assets.size(), 0);
+	const std::string* folder = NULL;
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		const std::string& path = sorted[i].first;
+		if (i > 0 && path == sorted[i - 1].first)
+			continue;
+		if (folder && path.compare(0, folder->length(), *folder) == 0)
+			continue;
+		keep[sorted[i].second] = 1;
+		if (recursive && assets[sorted[i].second].IsFolder())
+			folder = &path;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < assets.size(); ++i)
+	{
+		if (!keep[i])
+			continue;
+		if (kept != i)
+			assets[kept] = assets[i];
+		++kept;
+	}
+	assets.resize(kept);
+}
+
+bool IsServerVersionAtLeast(const std::string& serverVersion, int year, int release)
+{
+	// The release is the third field
+	std::string::size_type i = serverVersion.find('/');
+	if (i != std::string::npos)
+		i = serverVersion.find('/', i + 1);
+	if (i == std::string::npos)
+		return false;
+
+	int serverYear = 0;
+	int serverRelease = 0;
+	if (sscanf(serverVersion.c_str() + i + 1, "%d.%d", &serverYear, &serverRelease) != 2)
+		return false;
+	return serverYear > year || (serverYear == year && serverRelease >= release);
+}
@@ -3,6 +3,7 @@
  */
 #pragma once
 #include "VersionedAsset.h"
+#include <ostream>
 
 const int kPathWild        = 1 << 0;
 const int kPathRecursive   = 1 << 1;
@@ -18,6 +19,15 @@ std::string WildcardsAdd (const std::string& path);
 // Remove wildcards to a path, returning it to normal
 std::string WildcardsRemove (const std::string& path);
 
+// Buffer based versions of the above. Both do a single pass over the input and
+// return a pointer one past the last character written to out.
+// WildcardsAdd needs room for WildcardsAddedLength() characters in out (never
+// more than 3 * len) and WildcardsRemove never writes more than len characters.
+// out must not overlap path.
+size_t WildcardsAddedLength(const char* path, size_t len);
+char* WildcardsAdd(const char* path, size_t len, char* out);
+char* WildcardsRemove(const char* path, size_t len, char* out);
+
 // Construct path from asset and flags kPathWild, kPathRecursive
 std::string ResolvedPath(const VersionedAsset& asset, int flags);
 std::string ResolvePaths(VersionedAssetList::const_iterator b,
@@ -32,6 +42,42 @@ std::string ResolvePaths(const VersionedAssetList& list, int flags, const std::s
 void ResolvePaths(std::vector<std::string>& result, 
 				  const VersionedAssetList& list, int flags, const std::string& delim = "");
 
+// Builds the same path list as ResolvePaths() but computes the exact size of
+// the result up front so the paths can be encoded straight into a command line
+// or an argv vector without any intermediate strings.
+class PathListBuilder
+{
+public:
+	PathListBuilder(VersionedAssetList::const_iterator b, VersionedAssetList::const_iterator e,
+					int flags, const std::string& delim = "", const std::string& postfix = "");
+	PathListBuilder(const VersionedAssetList& list, int flags,
+					const std::string& delim = "", const std::string& postfix = "");
+
+	bool IsEmpty() const { return m_Length == 0; }
+	size_t GetLength() const { return m_Length; }
+
+	// Append the quoted path list e.g. to a command line
+	void AppendTo(std::string& target) const;
+
+	// Append one unquoted argument per path. Delimiter and postfix are not used.
+	void AppendTo(std::vector<std::string>& argv) const;
+
+	std::string ToString() const;
+
+private:
+	void ComputeLength();
+	bool IsSkipped(const VersionedAsset& asset) const;
+
+	VersionedAssetList::const_iterator m_Begin;
+	VersionedAssetList::const_iterator m_End;
+	int m_Flags;
+	std::string m_Delim;
+	std::string m_Postfix;
+	size_t m_Length;
+};
+
+std::ostream& operator<<(std::ostream& os, const PathListBuilder& paths);
+
 // Translates a workspace absolute path to p4 depot path
 std::string WorkspacePathToDepotPath(const std::string& root, const std::string& wp);
 
@@ -59,3 +105,12 @@ struct StateFilter
 void Partition(const StateFilter& filter, VersionedAssetList& l1_InOut,
 	VersionedAssetList& l2_Out);
 
+// Drop assets listed more than once and, if recursive, assets inside a folder
+// that is listed too. The first of each is kept and the order is unchanged.
+void RemoveOverlappingPaths(VersionedAssetList& assets, bool recursive);
+
+
+// True if a server version as reported by 'p4 info' e.g.
+// "P4D/LINUX26X86_64/2019.1/1796703 (2019/05/09)" is year.release or later.
+// False if it cannot be parsed.
+bool IsServerVersionAtLeast(const std::string& serverVersion, int year, int release);
@@ -0,0 +1,112 @@
+// Checks how the health monitor and the commands for Unity share the
+// connection, see P4ConnectionUse. The monitor loop is replayed on a clock of
+// its own so that a minute of idling takes no time.
+#include "P4ConnectionUse.h"
+#include "Thread.h"
+#include <stdio.h>
+#include <vector>
+
+// As in P4HealthMonitor.cpp
+const Microseconds MONITOR_INTERVAL_US = (Microseconds)1000 * 1000;
+const Microseconds KEEP_ALIVE_INTERVAL_US = (Microseconds)60 * 1000 * 1000;
+
+static int s_Failures = 0;
+
+static void Check(bool ok, const char* what)
+{
+	if (!ok)
+	{
+		++s_Failures;
+		fprintf(stderr, "FAIL %s\n", what);
+	}
+}
+
+// What P4HealthMonitor::KeepAlive() does with the connection. Returns true if
+// a keep alive was sent.
+static bool MonitorTick(P4ConnectionUse& use, Microseconds now)
+{
+	if (!use.TryAcquire())
+		return false;
+	bool due = use.IsIdleFor(KEEP_ALIVE_INTERVAL_US, now);
+	if (due)
+		use.MarkUsed(now);
+	use.Release();
+	return due;
+}
+
+// The monitor wakes up every second. Claiming the connection to look at it
+// must not count as using it, else an idle connection is never kept alive.
+static void CheckIdleKeepAlive()
+{
+	P4ConnectionUse use;
+	Microseconds start = GetMonotonicTime();
+	use.MarkUsed(start);
+
+	std::vector<Microseconds> sent;
+	for (Microseconds t = MONITOR_INTERVAL_US; t <= 3 * KEEP_ALIVE_INTERVAL_US; t += MONITOR_INTERVAL_US)
+	{
+		if (MonitorTick(use, start + t))
+			sent.push_back(t);
+	}
+
+	if (sent.size() != 3)
+		fprintf(stderr, "%d keep alives in 3 minutes\n", (int)sent.size());
+	Check(sent.size() == 3, "an idle connection gets a keep alive every minute");
+	for (size_t i = 0; i < sent.size() && i < 3; ++i)
+		Check(sent[i] == (i + 1) * KEEP_ALIVE_INTERVAL_US, "keep alive sent after 60 s of idling");
+}
+
+// A connection in use is left alone and counts as used when it is let go
+static void CheckBusyConnection()
+{
+	P4ConnectionUse use;
+	Microseconds start = GetMonotonicTime();
+	use.MarkUsed(start);
+
+	use.BeginUse();
+	Check(!use.TryAcquire(), "the monitor cannot claim a connection in use");
+	Check(!MonitorTick(use, start + 2 * KEEP_ALIVE_INTERVAL_US), "no keep alive while a command runs");
+	use.EndUse();
+	Check(!use.IsIdleFor(KEEP_ALIVE_INTERVAL_US, GetMonotonicTime()), "a command counts as using the connection");
+}
+
+static void UseMain(void* data)
+{
+	P4ConnectionUse* use = (P4ConnectionUse*)data;
+	use->BeginUse();
+	use->EndUse();
+}
+
+// A command waits for the monitor, which sees it waiting
+static void CheckWaitingCommand()
+{
+	P4ConnectionUse use;
+	Check(use.TryAcquire(), "the monitor claims an unused connection");
+	Check(!use.IsWanted(), "nobody waits at first");
+
+	Thread command;
+	command.Start(UseMain, &use);
+	bool wanted = false;
+	for (int i = 0; i < 1000 && !wanted; ++i)
+	{
+		wanted = use.IsWanted();
+		if (!wanted)
+			SleepMilliseconds(1);
+	}
+	Check(wanted, "the monitor sees a command waiting");
+
+	use.Release();
+	command.Join();
+	Check(!use.IsWanted(), "the command is done after the release");
+	Check(use.TryAcquire(), "the monitor can claim the connection again");
+	use.Release();
+}
+
+int main(int argc, char* argv[])
+{
+	CheckIdleKeepAlive();
+	CheckBusyConnection();
+	CheckWaitingCommand();
+	fprintf(stderr, "connection use: %d failed\n", s_Failures);
+	return s_Failures ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+// Measures the per record cost of the status reply hot path for different log
+// levels. The plugin protocol goes to stdout so run it as
+//   LogBenchmark > /dev/null
+#include "Connection.h"
+#include "VersionedAsset.h"
+#include "Metrics.h"
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int kRecords = 200000;
+
+// What P4StatusBaseCommand::OutputStat does for each file once the tagged
+// values have been parsed
+static void StatusRecord(Connection& conn, const VersionedAsset& asset, bool lazy, bool reply)
+{
+	std::string action("edit");
+	std::string headAction("edit");
+	std::string haveRev("3");
+	std::string headRev("4");
+	if (lazy)
+		DEBUG_LOG(conn.Log()) << asset.GetPath() << ": action '" << action << "', headAction '" << headAction
+							  << "', haveRev '" << haveRev << "', headRev '" << headRev << "' " << asset.GetState() << Endl;
+	else
+		conn.Log().Debug() << asset.GetPath() << ": action '" << action << "', headAction '" << headAction
+						   << "', haveRev '" << haveRev << "', headRev '" << headRev << "' " << asset.GetState() << Endl;
+	if (!reply)
+		return;
+	conn.VerboseLine(asset.GetPath());
+	conn << asset;
+}
+
+static void Run(Connection& conn, LogLevel level, bool lazy, bool reply, const char* name)
+{
+	conn.Log().SetLogLevel(level);
+	VersionedAsset asset("Assets/Textures/Environment/Rocks/rock_diffuse_01.png", kCheckedOutLocal | kLocal, "4");
+
+	Microseconds start = GetMonotonicTime();
+	for (int i = 0; i < kRecords; ++i)
+		StatusRecord(conn, asset, lazy, reply);
+	conn.Log().Sync();
+	Microseconds elapsed = GetMonotonicTime() - start;
+
+	fprintf(stderr, "%-28s %8.1f ns/record\n", name, (double)elapsed * 1000.0 / kRecords);
+}
+
+int main(int argc, char* argv[])
+{
+	Connection conn("./LogBenchmark.log");
+	conn.Connect();
+
+	fprintf(stderr, "%d status records, minimum compiled log level %d\n", kRecords, (int)LOG_MIN_LEVEL);
+	Run(conn, LOG_NOTICE, false, false, "log only, off, eager");
+	Run(conn, LOG_NOTICE, true, false, "log only, off, lazy");
+	Run(conn, LOG_DEBUG, true, false, "log only, debug on");
+	Run(conn, LOG_NOTICE, false, true, "reply, logging off, eager");
+	Run(conn, LOG_NOTICE, true, true, "reply, logging off, lazy");
+	Run(conn, LOG_DEBUG, true, true, "reply, debug logging on");
+
+	conn.Log().Shutdown();
+	remove("./LogBenchmark.log");
+	return 0;
+}
@@ -0,0 +1,263 @@
+// Checks the wildcard codec of P4Utility.cpp against the chain of Replace()
+// calls it took over from and measures both on Unity asset paths. The codec
+// has an AVX2, an SSE2 and a scalar path chosen when P4Utility.cpp is built,
+// see the wildcardtest target of the makefiles which runs it with each.
+//   WildcardTest [name of the code path]
+#include "P4Utility.h"
+#include "Metrics.h"
+#include "Utility.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const int kBenchmarkPaths = 20000;
+static const int kBenchmarkRounds = 20;
+
+static int s_Failures = 0;
+
+// What WildcardsAdd and WildcardsRemove did before the codec
+static std::string ReplaceWildcardsAdd(const std::string& pathIn)
+{
+	std::string path = Replace (pathIn, "%", "%25"); // Must be 1st :)
+	path = Replace (path, "#", "%23");
+	path = Replace (path, "@", "%40");
+	return Replace (path, "*", "%2A");
+}
+
+static std::string ReplaceWildcardsRemove(const std::string& pathIn)
+{
+	std::string path = Replace (pathIn, "%23", "#");
+	path = Replace (path, "%40", "@");
+	path = Replace (path, "%2A", "*");
+	return Replace (path, "%25", "%"); // Must do this last or we could convert an actual % to another wildcard
+}
+
+// Deterministic so that a failure can be reproduced on every platform
+static unsigned s_Random = 12345;
+static unsigned Random(unsigned range)
+{
+	s_Random = s_Random * 1103515245 + 12345;
+	return (s_Random >> 16) % range;
+}
+
+static std::string Printable(const std::string& s)
+{
+	std::string result;
+	for (std::string::const_iterator i = s.begin(); i != s.end(); ++i)
+	{
+		unsigned char c = (unsigned char)*i;
+		if (c >= 32 && c < 127)
+		{
+			result += *i;
+		}
+		else
+		{
+			char hex[8];
+			sprintf(hex, "\\x%02X", c);
+			result += hex;
+		}
+	}
+	return result;
+}
+
+static void Fail(const char* what, const std::string& input, const std::string& expected, const std::string& actual)
+{
+	if (++s_Failures <= 20)
+		fprintf(stderr, "FAIL %s \"%s\": expected \"%s\" got \"%s\"\n", what,
+				Printable(input).c_str(), Printable(expected).c_str(), Printable(actual).c_str());
+}
+
+// Both the string and the buffer forms with a guard after the output so that
+// writing past what the header promises shows up
+static void Check(const std::string& path)
+{
+	const char kGuard = '\x5A';
+
+	std::string expected = ReplaceWildcardsAdd(path);
+	std::string added = WildcardsAdd(path);
+	if (added != expected)
+		Fail("WildcardsAdd", path, expected, added);
+
+	size_t length = WildcardsAddedLength(path.data(), path.length());
+	std::vector<char> buffer(length + 1, kGuard);
+	char* end = WildcardsAdd(path.data(), path.length(), &buffer[0]);
+	std::string written(&buffer[0], end);
+	if (length != expected.length() || written != expected || buffer[length] != kGuard)
+		Fail("WildcardsAdd buffer", path, expected, written);
+
+	expected = ReplaceWildcardsRemove(path);
+	std::string removed = WildcardsRemove(path);
+	if (removed != expected)
+		Fail("WildcardsRemove", path, expected, removed);
+
+	buffer.assign(path.length() + 1, kGuard);
+	end = WildcardsRemove(path.data(), path.length(), &buffer[0]);
+	written.assign(&buffer[0], end);
+	if (written != expected || buffer[path.length()] != kGuard)
+		Fail("WildcardsRemove buffer", path, expected, written);
+
+	removed = WildcardsRemove(added);
+	if (removed != path)
+		Fail("round trip", path, path, removed);
+}
+
+// Every string up to four characters made of the wildcards, the characters of
+// their codes and one other
+static int CheckShort()
+{
+	const char kChars[] = "%#@*2345A0ax";
+	const size_t kCount = sizeof(kChars) - 1;
+	int checked = 0;
+	std::string s;
+	for (size_t len = 0; len <= 4; ++len)
+	{
+		size_t combinations = 1;
+		for (size_t i = 0; i < len; ++i)
+			combinations *= kCount;
+		for (size_t n = 0; n < combinations; ++n)
+		{
+			s.clear();
+			for (size_t i = 0, k = n; i < len; ++i, k /= kCount)
+				s += kChars[k % kCount];
+			Check(s);
+			++checked;
+		}
+	}
+	return checked;
+}
+
+// A wildcard or code at every position of plain paths around the 16 and 32
+// byte blocks the vector paths work on, also cut short at the end
+static int CheckBlocks()
+{
+	const char* kInserts[] = { "%", "#", "@", "*", "%25", "%23", "%40", "%2A", "%2a", "%2", "%4", "%%", "%2523", "\xC3\xA9" };
+	const size_t kInsertCount = sizeof(kInserts) / sizeof(kInserts[0]);
+	int checked = 0;
+	for (size_t len = 0; len <= 100; ++len)
+	{
+		std::string plain;
+		for (size_t i = 0; i < len; ++i)
+			plain += (char)('a' + i % 26);
+		Check(plain);
+		++checked;
+
+		for (size_t at = 0; at <= len; ++at)
+		{
+			for (size_t k = 0; k < kInsertCount; ++k)
+			{
+				std::string s = plain;
+				s.insert(at, kInserts[k]);
+				Check(s);
+				Check(s.substr(0, s.length() - 1));
+				checked += 2;
+			}
+		}
+	}
+	return checked;
+}
+
+// Random strings with many wildcards and codes, non-ASCII bytes included
+static int CheckRandom()
+{
+	const char* kPieces[] = { "%", "#", "@", "*", "%25", "%23", "%40", "%2A", "2", "5", "A", "/", "Assets", ".png", "\xE6\x97\xA5\xE6\x9C\xAC", "\xC3\xA9", "\xFF", "\x80" };
+	const size_t kPieceCount = sizeof(kPieces) / sizeof(kPieces[0]);
+	const int kStrings = 100000;
+	for (int n = 0; n < kStrings; ++n)
+	{
+		std::string s;
+		unsigned pieces = Random(40);
+		for (unsigned i = 0; i < pieces; ++i)
+		{
+			if (Random(3) == 0)
+				s += kPieces[Random(kPieceCount)];
+			else
+				s += (char)(Random(255) + 1);
+		}
+		Check(s);
+	}
+	return kStrings;
+}
+
+// Paths as found in Unity projects. A few have '@' as used for the variants
+// of icons and animations.
+static void MakeAssetPaths(std::vector<std::string>& paths)
+{
+	const char* kFolders[] = {
+		"Assets/Art/Characters/Hero/Textures/",
+		"Assets/Art/Environment/Forest/Prefabs/",
+		"Assets/Scripts/Gameplay/Inventory/",
+		"Assets/Audio/Music/",
+		"Assets/UI/Icons/",
+		"Assets/Animations/Hero@Run/",
+		"Packages/com.company.tools/Editor/",
+		"ProjectSettings/",
+	};
+	const char* kNames[] = { "hero_diffuse", "TreeLarge", "InventorySlotView", "main_theme", "icon_sword@2x", "Run", "AssetPostprocessor", "TagManager" };
+	const char* kExtensions[] = { ".png", ".prefab", ".cs", ".ogg", ".png", ".anim", ".cs", ".asset" };
+	const size_t kFolderCount = sizeof(kFolders) / sizeof(kFolders[0]);
+
+	char number[16];
+	for (int i = 0; i < kBenchmarkPaths; ++i)
+	{
+		size_t k = Random(kFolderCount);
+		sprintf(number, "_%02d", i % 100);
+		paths.push_back(std::string("/Users/dev/Projects/Game/") + kFolders[k] + kNames[k] + number + kExtensions[k]);
+		if (i % 2 == 0)
+			paths.push_back(paths.back() + ".meta");
+	}
+}
+
+typedef std::string (*Codec)(const std::string&);
+
+static double Time(Codec codec, const std::vector<std::string>& paths, size_t& bytes)
+{
+	Microseconds start = GetMonotonicTime();
+	for (int round = 0; round < kBenchmarkRounds; ++round)
+	{
+		for (std::vector<std::string>::const_iterator i = paths.begin(); i != paths.end(); ++i)
+			bytes += codec(*i).length();
+	}
+	Microseconds elapsed = GetMonotonicTime() - start;
+	return (double)elapsed * 1000.0 / ((double)paths.size() * kBenchmarkRounds);
+}
+
+static void Benchmark()
+{
+	std::vector<std::string> paths;
+	MakeAssetPaths(paths);
+	std::vector<std::string> depotPaths;
+	for (std::vector<std::string>::const_iterator i = paths.begin(); i != paths.end(); ++i)
+		depotPaths.push_back(WildcardsAdd(*i));
+
+	// Summed so the calls cannot be left out
+	size_t bytes = 0;
+	fprintf(stderr, "%d asset paths\n", (int)paths.size());
+	fprintf(stderr, "%-28s %8.1f ns/path\n", "add, Replace chain", Time(ReplaceWildcardsAdd, paths, bytes));
+	fprintf(stderr, "%-28s %8.1f ns/path\n", "add, codec", Time(WildcardsAdd, paths, bytes));
+	fprintf(stderr, "%-28s %8.1f ns/path\n", "remove, Replace chain", Time(ReplaceWildcardsRemove, depotPaths, bytes));
+	fprintf(stderr, "%-28s %8.1f ns/path\n", "remove, codec", Time(WildcardsRemove, depotPaths, bytes));
+	fprintf(stderr, "(%lu bytes)\n", (unsigned long)bytes);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* name = argc > 1 ? argv[1] : "default";
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (strcmp(name, "avx2") == 0 && !__builtin_cpu_supports("avx2"))
+	{
+		fprintf(stderr, "%s: skipped, not supported by this CPU\n", name);
+		return 0;
+	}
+#endif
+
+	int checked = CheckShort();
+	checked += CheckBlocks();
+	checked += CheckRandom();
+	fprintf(stderr, "%s: %d paths checked, %d failed\n", name, checked, s_Failures);
+	if (s_Failures)
+		return 1;
+
+	Benchmark();
+	return 0;
+}